@@ -14,3 +14,13 @@ proc web::interpmap {file} {
 }
 
 web::interpclasscfg $CWD/docs/pool2.ws3 maxrequests 10
+
+# one interp: the second is created with the budget used up (by the first,
+# expired after maxttl)
+web::interpclasscfg $CWD/docs/budget.ws3 maxinterps 1
+web::interpclasscfg $CWD/docs/budget.ws3 maxttl 1
+web::interpclasscfg $CWD/docs/budget.ws3 maxrequests 0
+
+# interps grown to 20 MB are recycled
+web::interpclasscfg $CWD/docs/memory.ws3 maxmemory 20000
+web::interpclasscfg $CWD/docs/memory.ws3 maxrequests 0
@@ -0,0 +1,343 @@
+/*
+ * admission.c -- admission control per interp class for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include "hashutl.h"
+#include "webutl.h"
+#include "admission.h"
+
+static Tcl_HashTable *admissionClasses = NULL;
+TCL_DECLARE_MUTEX(admissionLock)
+
+/* ----------------------------------------------------------------------------
+ * isActive -- no locking at all unless a limit was set for the class
+ * ------------------------------------------------------------------------- */
+static int isActive(AdmissionClass * admission)
+{
+#ifdef __GNUC__
+    return __atomic_load_n(&(admission->active), __ATOMIC_ACQUIRE);
+#else
+    int active;
+
+    Tcl_MutexLock(&admissionLock);
+    active = admission->active;
+    Tcl_MutexUnlock(&admissionLock);
+    return active;
+#endif
+}
+
+static void setActive(AdmissionClass * admission)
+{
+    int active = (admission->maxconcurrent > 0 || admission->maxcreaterate > 0);
+#ifdef __GNUC__
+    __atomic_store_n(&(admission->active), active, __ATOMIC_RELEASE);
+#else
+    admission->active = active;
+#endif
+}
+
+static Tcl_WideInt now(void)
+{
+    Tcl_Time time;
+
+    Tcl_GetTime(&time);
+    return (Tcl_WideInt) time.sec * 1000000 + time.usec;
+}
+
+/* ----------------------------------------------------------------------------
+ * startWaiting, stopWaiting (locked) -- queue bookkeeping. startWaiting
+ * returns 0 if the queue is full.
+ * ------------------------------------------------------------------------- */
+static int startWaiting(AdmissionClass * admission)
+{
+    if (admission->waiting >= admission->maxqueue) {
+	admission->rejected++;
+	return 0;
+    }
+    admission->waiting++;
+    admission->queued++;
+    if (admission->waiting > admission->maxwaiting)
+	admission->maxwaiting = admission->waiting;
+    return 1;
+}
+
+static void stopWaiting(AdmissionClass * admission, Tcl_WideInt start,
+			int timedout)
+{
+    admission->waiting--;
+    admission->waittime += now() - start;
+    if (timedout)
+	admission->timedout++;
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionGetClass -- the limits of classid (shared by all threads)
+ * ------------------------------------------------------------------------- */
+AdmissionClass *admissionGetClass(const char *classid)
+{
+    Tcl_HashEntry *hashEntry;
+    AdmissionClass *admission;
+    int isNew = 0;
+
+    Tcl_MutexLock(&admissionLock);
+
+    if (admissionClasses == NULL) {
+	HashUtlAllocInit(admissionClasses, TCL_STRING_KEYS);
+    }
+
+    hashEntry = Tcl_CreateHashEntry(admissionClasses, classid, &isNew);
+    if (isNew) {
+	admission = WebAllocInternalData(AdmissionClass);
+	memset(admission, 0, sizeof(AdmissionClass));
+	admission->classid = allocAndSet((char *) classid);
+	admission->queuetimeout = WEB_ADMISSION_TIMEOUT;
+	admission->cond = NULL;
+	Tcl_SetHashValue(hashEntry, (ClientData) admission);
+    } else {
+	admission = (AdmissionClass *) Tcl_GetHashValue(hashEntry);
+    }
+
+    Tcl_MutexUnlock(&admissionLock);
+
+    return admission;
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionGetLimit, admissionSetLimit -- class options (0: no limit)
+ * ------------------------------------------------------------------------- */
+long admissionGetLimit(AdmissionClass * admission, AdmissionLimit limit)
+{
+    long value = 0;
+
+    Tcl_MutexLock(&admissionLock);
+    switch (limit) {
+    case ADMISSION_MAXCONCURRENT:
+	value = admission->maxconcurrent;
+	break;
+    case ADMISSION_MAXCREATERATE:
+	value = admission->maxcreaterate;
+	break;
+    case ADMISSION_MAXQUEUE:
+	value = admission->maxqueue;
+	break;
+    case ADMISSION_QUEUETIMEOUT:
+	value = admission->queuetimeout;
+	break;
+    }
+    Tcl_MutexUnlock(&admissionLock);
+
+    return value;
+}
+
+void admissionSetLimit(AdmissionClass * admission, AdmissionLimit limit,
+		       long value)
+{
+    if (value < 0)
+	value = 0;
+
+    Tcl_MutexLock(&admissionLock);
+    switch (limit) {
+    case ADMISSION_MAXCONCURRENT:
+	admission->maxconcurrent = value;
+	break;
+    case ADMISSION_MAXCREATERATE:
+	admission->maxcreaterate = value;
+	admission->nextcreate = 0;
+	break;
+    case ADMISSION_MAXQUEUE:
+	admission->maxqueue = value;
+	break;
+    case ADMISSION_QUEUETIMEOUT:
+	admission->queuetimeout = value;
+	break;
+    }
+    setActive(admission);
+    /* waiting requests re-check the new limits */
+    Tcl_ConditionNotify(&(admission->cond));
+    Tcl_MutexUnlock(&admissionLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionEnter -- a request of the class wants to run. Waits for a slot
+ * if maxconcurrent requests are running already. Unless ADMISSION_NONE or
+ * ADMISSION_OK is returned, the request must be refused.
+ * Every ADMISSION_OK must be paired with admissionLeave.
+ * ------------------------------------------------------------------------- */
+AdmissionResult admissionEnter(AdmissionClass * admission)
+{
+    Tcl_WideInt start, deadline, remaining;
+    Tcl_Time timeout;
+
+    if (!isActive(admission))
+	return ADMISSION_NONE;
+
+    Tcl_MutexLock(&admissionLock);
+
+    if (admission->maxconcurrent > 0
+	&& admission->running >= admission->maxconcurrent) {
+
+	if (!startWaiting(admission)) {
+	    Tcl_MutexUnlock(&admissionLock);
+	    return ADMISSION_FULL;
+	}
+
+	start = now();
+	deadline = start + (Tcl_WideInt) admission->queuetimeout * 1000;
+
+	while (admission->maxconcurrent > 0
+	       && admission->running >= admission->maxconcurrent) {
+	    remaining = deadline - now();
+	    if (remaining <= 0) {
+		stopWaiting(admission, start, 1);
+		Tcl_MutexUnlock(&admissionLock);
+		return ADMISSION_TIMEOUT;
+	    }
+	    timeout.sec = (long) (remaining / 1000000);
+	    timeout.usec = (long) (remaining % 1000000);
+	    Tcl_ConditionWait(&(admission->cond), &admissionLock, &timeout);
+	}
+
+	stopWaiting(admission, start, 0);
+    }
+
+    admission->running++;
+    admission->admitted++;
+
+    Tcl_MutexUnlock(&admissionLock);
+
+    return ADMISSION_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionLeave -- the request is done, wake up the queue
+ * ------------------------------------------------------------------------- */
+void admissionLeave(AdmissionClass * admission)
+{
+    Tcl_MutexLock(&admissionLock);
+    if (admission->running > 0)
+	admission->running--;
+    Tcl_ConditionNotify(&(admission->cond));
+    Tcl_MutexUnlock(&admissionLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionCreate -- an interp of the class is about to be created.
+ * maxcreaterate is enforced as a generic cell rate: one creation every
+ * 1/maxcreaterate seconds with a burst of one second worth. Sleeps until
+ * the next creation is due, or refuses if that is after queuetimeout.
+ * ------------------------------------------------------------------------- */
+AdmissionResult admissionCreate(AdmissionClass * admission)
+{
+    Tcl_WideInt start, interval, due, wait;
+
+    if (!isActive(admission))
+	return ADMISSION_NONE;
+
+    Tcl_MutexLock(&admissionLock);
+
+    if (admission->maxcreaterate <= 0) {
+	Tcl_MutexUnlock(&admissionLock);
+	return ADMISSION_NONE;
+    }
+
+    start = now();
+    interval = 1000000 / admission->maxcreaterate;
+    due = admission->nextcreate > start ? admission->nextcreate : start;
+    wait = due - (1000000 - interval) - start;
+
+    if (wait <= 0) {
+	admission->nextcreate = due + interval;
+	Tcl_MutexUnlock(&admissionLock);
+	return ADMISSION_OK;
+    }
+
+    if (!startWaiting(admission)) {
+	Tcl_MutexUnlock(&admissionLock);
+	return ADMISSION_FULL;
+    }
+
+    if (wait > (Tcl_WideInt) admission->queuetimeout * 1000) {
+	stopWaiting(admission, start, 1);
+	Tcl_MutexUnlock(&admissionLock);
+	return ADMISSION_TIMEOUT;
+    }
+
+    /* reserve the slot, then sleep without the lock */
+    admission->nextcreate = due + interval;
+    Tcl_MutexUnlock(&admissionLock);
+
+    Tcl_Sleep((int) ((wait + 999) / 1000));
+
+    Tcl_MutexLock(&admissionLock);
+    stopWaiting(admission, start, 0);
+    Tcl_MutexUnlock(&admissionLock);
+
+    return ADMISSION_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionStats -- counters as dict
+ * ------------------------------------------------------------------------- */
+Tcl_Obj *admissionStats(AdmissionClass * admission)
+{
+    Tcl_Obj *result = Tcl_NewObj();
+
+    Tcl_MutexLock(&admissionLock);
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("running", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->running));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("waiting", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->waiting));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("maxwaiting", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->maxwaiting));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("admitted", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->admitted));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("queued", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->queued));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("rejected", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->rejected));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("timedout", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewLongObj(admission->timedout));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj("waittime", -1));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(admission->waittime));
+    Tcl_MutexUnlock(&admissionLock);
+
+    return result;
+}
+
+/* ----------------------------------------------------------------------------
+ * admissionFinalize -- no requests are running any more
+ * ------------------------------------------------------------------------- */
+void admissionFinalize(void)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+    AdmissionClass *admission;
+
+    Tcl_MutexLock(&admissionLock);
+
+    if (admissionClasses != NULL) {
+	while ((hashEntry = Tcl_FirstHashEntry(admissionClasses, &search)) != NULL) {
+	    admission = (AdmissionClass *) Tcl_GetHashValue(hashEntry);
+	    Tcl_ConditionFinalize(&(admission->cond));
+	    Tcl_Free(admission->classid);
+	    Tcl_Free((char *) admission);
+	    Tcl_DeleteHashEntry(hashEntry);
+	}
+	HashUtlDelFree(admissionClasses);
+	admissionClasses = NULL;
+    }
+
+    Tcl_MutexUnlock(&admissionLock);
+}
@@ -0,0 +1,86 @@
+/*
+ * admission.h -- admission control per interp class for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_ADMISSION_H
+#define WEB_ADMISSION_H
+
+#include "tcl.h"
+
+/* ----------------------------------------------------------------------------
+ * process-wide limits per class id, shared by all threads:
+ * - maxconcurrent: requests of the class running at the same time
+ * - maxcreaterate: interps of the class created per second (a burst of
+ *   one second worth is allowed)
+ * Requests over a limit wait in a queue of at most maxqueue requests for
+ * at most queuetimeout milliseconds. Nothing is locked for classes
+ * without limits. AdmissionClass entries live until admissionFinalize.
+ * ------------------------------------------------------------------------- */
+
+#define WEB_ADMISSION_TIMEOUT 10000	/* default queuetimeout (ms) */
+
+typedef enum AdmissionResult
+{
+    ADMISSION_NONE,		/* no limits, nothing to leave */
+    ADMISSION_OK, ADMISSION_FULL, ADMISSION_TIMEOUT
+}
+AdmissionResult;
+
+typedef enum AdmissionLimit
+{
+    ADMISSION_MAXCONCURRENT, ADMISSION_MAXCREATERATE,
+    ADMISSION_MAXQUEUE, ADMISSION_QUEUETIMEOUT
+}
+AdmissionLimit;
+
+typedef struct AdmissionClass
+{
+    char *classid;
+    int active;			/* any limit set */
+
+    /* limits */
+    long maxconcurrent;
+    long maxcreaterate;
+    long maxqueue;
+    long queuetimeout;
+
+    /* state */
+    long running;		/* admitted requests */
+    long waiting;		/* queue depth */
+    Tcl_WideInt nextcreate;	/* theoretical time of the next creation (usec) */
+    Tcl_Condition cond;
+
+    /* counters */
+    long admitted;
+    long queued;		/* ... of them had to wait */
+    long maxwaiting;		/* deepest queue */
+    long rejected;		/* queue was full */
+    long timedout;		/* waited too long */
+    Tcl_WideInt waittime;	/* total time spent waiting (usec) */
+}
+AdmissionClass;
+
+AdmissionClass *admissionGetClass(const char *classid);
+long admissionGetLimit(AdmissionClass * admission, AdmissionLimit limit);
+void admissionSetLimit(AdmissionClass * admission, AdmissionLimit limit,
+		       long value);
+
+AdmissionResult admissionEnter(AdmissionClass * admission);
+AdmissionResult admissionCreate(AdmissionClass * admission);
+void admissionLeave(AdmissionClass * admission);
+Tcl_Obj *admissionStats(AdmissionClass * admission);
+
+void admissionFinalize(void);
+
+#endif
@@ -37,6 +37,21 @@
 
 #include "request.h"
 
+#define APCHANNEL_BUFSIZE 65536
+
+#ifdef APACHE2
+/* one brigade per request, emptied after every write */
+typedef struct ApchannelData
+{
+    request_rec *r;
+    apr_bucket_brigade *bb;
+}
+ApchannelData;
+#define APCHANNEL_REQUEST(clientData) (((ApchannelData *) (clientData))->r)
+#else /* APACHE2 */
+#define APCHANNEL_REQUEST(clientData) ((request_rec *) (clientData))
+#endif /* APACHE2 */
+
 /* ----------------------------------------------------------------------------
  * close apache channel
  * ------------------------------------------------------------------------- */
@@ -60,7 +75,7 @@ int apchannelInputProc(ClientData clientData,
 
     if ((clientData == NULL) || (buf == NULL))
 	return res;
-    r = (request_rec *) clientData;
+    r = APCHANNEL_REQUEST(clientData);
 
     if (bufSize > 0)
 	res = ap_get_client_block(r, buf, bufSize);
@@ -85,7 +100,21 @@ int apchannelOutputProc(ClientData clientData,
 
 
     if (toWrite > 0) {
+#ifdef APACHE2
+	ApchannelData *data = (ApchannelData *) clientData;
+	apr_bucket_brigade *bb = data->bb;
+	apr_status_t rv;
+
+	/* filters that keep the data set the transient bucket aside */
+	APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(buf, toWrite,
+							       bb->bucket_alloc));
+	rv = ap_pass_brigade(data->r->output_filters, bb);
+	apr_brigade_cleanup(bb);
+	if (rv == APR_SUCCESS)
+	    res = toWrite;
+#else /* APACHE2 */
 	res = ap_rwrite((void *) buf, toWrite, (request_rec *) clientData);
+#endif /* APACHE2 */
     }
     if (res < 0)
 	return -1;
@@ -133,21 +162,120 @@ int createApchannel(Tcl_Interp * interp, request_rec * r)
 {
 
     Tcl_Channel channel = NULL;
+    ClientData clientData = (ClientData) r;
     int flag = 0;
 
     if ((interp == NULL) || (r == NULL))
 	return TCL_ERROR;
 
+#ifdef APACHE2
+    {
+	ApchannelData *data =
+	    (ApchannelData *) apr_palloc(r->pool, sizeof(ApchannelData));
+	data->r = r;
+	data->bb = apr_brigade_create(r->pool, r->connection->bucket_alloc);
+	clientData = (ClientData) data;
+    }
+#endif /* APACHE2 */
+
     flag = TCL_WRITABLE;
     if (ap_should_client_block(r)) {
 	flag = TCL_WRITABLE | TCL_READABLE;
     }
 
-    channel = Tcl_CreateChannel(&apChannelType, APCHANNEL, (ClientData) r, flag);
+    channel = Tcl_CreateChannel(&apChannelType, APCHANNEL, clientData, flag);
 
     if (channel == NULL)
 	return TCL_ERROR;
 
+    /* the output buffer is handed over in a few large pieces */
+    Tcl_SetChannelBufferSize(channel, APCHANNEL_BUFSIZE);
+
+    Tcl_RegisterChannel(interp, channel);
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * finished apache channel -- stands in for the apache channel after the
+ * end of the response: output of web::onexit and web::defer is discarded
+ * and logged once per request
+ * ------------------------------------------------------------------------- */
+typedef struct FinishedApchannelData
+{
+    request_rec *r;
+    int warned;
+}
+FinishedApchannelData;
+
+int finishedApchannelOutputProc(ClientData clientData,
+				TCLCONST char *buf, int toWrite,
+				int *errorCodePtr)
+{
+
+    FinishedApchannelData *data = (FinishedApchannelData *) clientData;
+
+    if ((data == NULL) || (buf == NULL))
+	return -1;
+
+    if ((toWrite > 0) && !data->warned) {
+	data->warned = 1;
+#ifdef APACHE2
+	ap_log_rerror(APLOG_MARK, APLOG_NOERRNO | APLOG_WARNING, 0, data->r,
+		      "mod_websh - output after the end of the response "
+		      "(web::onexit, web::defer) is discarded");
+#else /* APACHE2 */
+	ap_log_rerror(APLOG_MARK, APLOG_WARNING, data->r,
+		      "mod_websh - output after the end of the response "
+		      "(web::onexit, web::defer) is discarded");
+#endif /* APACHE2 */
+    }
+    return toWrite;
+}
+
+static Tcl_ChannelType finishedApChannelType = {
+    "file",			/* Type name. */
+    NULL,			/* Set blocking/nonblocking mode. */
+    apchannelCloseProc,		/* Close proc. */
+    NULL,			/* Input proc. */
+    finishedApchannelOutputProc,	/* Output proc. */
+    NULL,			/* Seek proc. */
+    NULL,			/* Set option proc. */
+    NULL,			/* Get option proc. */
+    apchannelWatchProc,		/* Initialize notifier. */
+    apchannelGetHandleProc,	/* Get OS handles out of channel. */
+};
+
+/* ----------------------------------------------------------------------------
+ * createFinishedApchannel -- replaces the apache channel (destroyed before)
+ * ------------------------------------------------------------------------- */
+int createFinishedApchannel(Tcl_Interp * interp, request_rec * r)
+{
+
+    Tcl_Channel channel = NULL;
+    FinishedApchannelData *data = NULL;
+
+    if ((interp == NULL) || (r == NULL))
+	return TCL_ERROR;
+
+#ifdef APACHE2
+    data = (FinishedApchannelData *) apr_palloc(r->pool,
+					sizeof(FinishedApchannelData));
+#else /* APACHE2 */
+    data = (FinishedApchannelData *) ap_palloc(r->pool,
+					sizeof(FinishedApchannelData));
+#endif /* APACHE2 */
+    data->r = r;
+    data->warned = 0;
+
+    channel = Tcl_CreateChannel(&finishedApChannelType, APCHANNEL,
+				(ClientData) data, TCL_WRITABLE);
+
+    if (channel == NULL)
+	return TCL_ERROR;
+
+    Tcl_SetChannelOption(interp, channel, "-buffering", "none");
+
     Tcl_RegisterChannel(interp, channel);
 
     return TCL_OK;
@@ -0,0 +1,347 @@
+/*
+ * budget.c -- process-wide budget of interpreters for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include "hashutl.h"
+#include "webutl.h"
+#include "budget.h"
+
+static int budgetActive = 0;	/* set once a budget is configured */
+static long budgetMax = 0;	/* WebshMaxInterps */
+static long budgetCount = 0;	/* interps counted */
+static BudgetLink *lruFirst = NULL;	/* least recently used free interp */
+static BudgetLink *lruLast = NULL;
+static Tcl_HashTable *budgetClasses = NULL;
+TCL_DECLARE_MUTEX(budgetLock)
+
+/* ----------------------------------------------------------------------------
+ * isActive -- no locking at all unless a budget was set
+ * ------------------------------------------------------------------------- */
+static int isActive(void)
+{
+#ifdef __GNUC__
+    return __atomic_load_n(&budgetActive, __ATOMIC_ACQUIRE);
+#else
+    int active;
+
+    Tcl_MutexLock(&budgetLock);
+    active = budgetActive;
+    Tcl_MutexUnlock(&budgetLock);
+    return active;
+#endif
+}
+
+static void setActive(void)
+{
+#ifdef __GNUC__
+    __atomic_store_n(&budgetActive, 1, __ATOMIC_RELEASE);
+#else
+    budgetActive = 1;
+#endif
+}
+
+/* ----------------------------------------------------------------------------
+ * LRU list (locked)
+ * ------------------------------------------------------------------------- */
+static void lruUnlink(BudgetLink * link)
+{
+    if (!link->linked)
+	return;
+
+    if (link->prev != NULL)
+	link->prev->next = link->next;
+    else
+	lruFirst = link->next;
+
+    if (link->next != NULL)
+	link->next->prev = link->prev;
+    else
+	lruLast = link->prev;
+
+    link->prev = NULL;
+    link->next = NULL;
+    link->linked = 0;
+}
+
+static void uncount(BudgetLink * link)
+{
+    if (!link->counted)
+	return;
+
+    budgetCount--;
+    if (link->budgetClass != NULL)
+	link->budgetClass->count--;
+    link->counted = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * evictLru (locked) -- mark the least recently used free interp (of
+ * budgetClass, if not NULL) as evicted. Returns 0 if there is none.
+ * ------------------------------------------------------------------------- */
+static int evictLru(BudgetClass * budgetClass)
+{
+    BudgetLink *link;
+
+    for (link = lruFirst; link != NULL; link = link->next) {
+	if (budgetClass == NULL || link->budgetClass == budgetClass)
+	    break;
+    }
+    if (link == NULL)
+	return 0;
+
+    lruUnlink(link);
+    uncount(link);
+#ifdef __GNUC__
+    __atomic_store_n(&(link->evicted), 1, __ATOMIC_RELEASE);
+#else
+    link->evicted = 1;
+#endif
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetSetMax -- WebshMaxInterps (0: no limit)
+ * ------------------------------------------------------------------------- */
+void budgetSetMax(long maxInterps)
+{
+    Tcl_MutexLock(&budgetLock);
+    budgetMax = maxInterps;
+    if (maxInterps > 0)
+	setActive();
+    Tcl_MutexUnlock(&budgetLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetGetClass -- the budget of classid (shared by all threads)
+ * ------------------------------------------------------------------------- */
+BudgetClass *budgetGetClass(const char *classid)
+{
+    Tcl_HashEntry *hashEntry;
+    BudgetClass *budgetClass;
+    int isNew = 0;
+
+    Tcl_MutexLock(&budgetLock);
+
+    if (budgetClasses == NULL) {
+	HashUtlAllocInit(budgetClasses, TCL_STRING_KEYS);
+    }
+
+    hashEntry = Tcl_CreateHashEntry(budgetClasses, classid, &isNew);
+    if (isNew) {
+	budgetClass = WebAllocInternalData(BudgetClass);
+	budgetClass->classid = allocAndSet((char *) classid);
+	budgetClass->count = 0;
+	budgetClass->max = 0;
+	Tcl_SetHashValue(hashEntry, (ClientData) budgetClass);
+    } else {
+	budgetClass = (BudgetClass *) Tcl_GetHashValue(hashEntry);
+    }
+
+    Tcl_MutexUnlock(&budgetLock);
+
+    return budgetClass;
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetSetClassMax -- maxinterps of a class (0: no limit)
+ * ------------------------------------------------------------------------- */
+void budgetSetClassMax(BudgetClass * budgetClass, long max)
+{
+    Tcl_MutexLock(&budgetLock);
+    budgetClass->max = max;
+    if (max > 0)
+	setActive();
+    Tcl_MutexUnlock(&budgetLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetAdd -- count a new interp. If the budget is used up, the LRU free
+ * interp is evicted to make room. Without evict (spare interps), returns 0
+ * instead and the interp should not be created.
+ * If all interps are in use, the new one is counted anyway (returns 1).
+ * ------------------------------------------------------------------------- */
+int budgetAdd(BudgetLink * link, BudgetClass * budgetClass, int evict)
+{
+    link->prev = NULL;
+    link->next = NULL;
+    link->budgetClass = budgetClass;
+    link->counted = 0;
+    link->linked = 0;
+    link->evicted = 0;
+
+    if (!isActive())
+	return 1;
+
+    Tcl_MutexLock(&budgetLock);
+
+    if (budgetClass != NULL && budgetClass->max > 0
+	&& budgetClass->count >= budgetClass->max) {
+	if (!evict) {
+	    Tcl_MutexUnlock(&budgetLock);
+	    return 0;
+	}
+	evictLru(budgetClass);
+    }
+
+    if (budgetMax > 0 && budgetCount >= budgetMax) {
+	if (!evict) {
+	    Tcl_MutexUnlock(&budgetLock);
+	    return 0;
+	}
+	evictLru(NULL);
+    }
+
+    budgetCount++;
+    if (budgetClass != NULL)
+	budgetClass->count++;
+    link->counted = 1;
+
+    Tcl_MutexUnlock(&budgetLock);
+
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetRemove -- interp is destroyed
+ * ------------------------------------------------------------------------- */
+void budgetRemove(BudgetLink * link)
+{
+    if (!isActive())
+	return;
+
+    Tcl_MutexLock(&budgetLock);
+    lruUnlink(link);
+    uncount(link);
+    Tcl_MutexUnlock(&budgetLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetPushFree -- interp is free again, it is the most recently used
+ * ------------------------------------------------------------------------- */
+void budgetPushFree(BudgetLink * link)
+{
+    if (!isActive())
+	return;
+
+    Tcl_MutexLock(&budgetLock);
+    if (link->counted) {
+	lruUnlink(link);
+	link->prev = lruLast;
+	link->next = NULL;
+	if (lruLast != NULL)
+	    lruLast->next = link;
+	else
+	    lruFirst = link;
+	lruLast = link;
+	link->linked = 1;
+    }
+    Tcl_MutexUnlock(&budgetLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetTakeFree -- owner takes a free interp. Returns 0 if it was
+ * evicted and must be destroyed instead. counted and linked are changed
+ * by the evictor, they are only looked at under the lock.
+ * ------------------------------------------------------------------------- */
+int budgetTakeFree(BudgetLink * link)
+{
+    int ok = 1;
+
+    if (!isActive())
+	return 1;
+
+    Tcl_MutexLock(&budgetLock);
+    if (link->evicted)
+	ok = 0;
+    else
+	lruUnlink(link);
+    Tcl_MutexUnlock(&budgetLock);
+
+    return ok;
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetTake -- interp is reserved for a request: out of the LRU list, so
+ * other threads cannot evict it while it is in use. Returns 0 if it was
+ * evicted before; it is counted again (it is in use, like a new interp
+ * when all are busy) and must be destroyed after the request.
+ * ------------------------------------------------------------------------- */
+int budgetTake(BudgetLink * link)
+{
+    int ok = 1;
+
+    if (!isActive())
+	return 1;
+
+    Tcl_MutexLock(&budgetLock);
+    lruUnlink(link);
+    if (link->evicted) {
+	ok = 0;
+	if (!link->counted) {
+	    budgetCount++;
+	    if (link->budgetClass != NULL)
+		link->budgetClass->count++;
+	    link->counted = 1;
+	}
+    }
+    Tcl_MutexUnlock(&budgetLock);
+
+    return ok;
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetEvicted -- check without lock (reaper)
+ * ------------------------------------------------------------------------- */
+int budgetEvicted(BudgetLink * link)
+{
+#ifdef __GNUC__
+    return __atomic_load_n(&(link->evicted), __ATOMIC_ACQUIRE);
+#else
+    int evicted;
+
+    Tcl_MutexLock(&budgetLock);
+    evicted = link->evicted;
+    Tcl_MutexUnlock(&budgetLock);
+    return evicted;
+#endif
+}
+
+/* ----------------------------------------------------------------------------
+ * budgetFinalize -- all interps are gone
+ * ------------------------------------------------------------------------- */
+void budgetFinalize(void)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+    BudgetClass *budgetClass;
+
+    Tcl_MutexLock(&budgetLock);
+
+    if (budgetClasses != NULL) {
+	while ((hashEntry = Tcl_FirstHashEntry(budgetClasses, &search)) != NULL) {
+	    budgetClass = (BudgetClass *) Tcl_GetHashValue(hashEntry);
+	    Tcl_Free(budgetClass->classid);
+	    Tcl_Free((char *) budgetClass);
+	    Tcl_DeleteHashEntry(hashEntry);
+	}
+	HashUtlDelFree(budgetClasses);
+	budgetClasses = NULL;
+    }
+    budgetCount = 0;
+    lruFirst = NULL;
+    lruLast = NULL;
+
+    Tcl_MutexUnlock(&budgetLock);
+}
@@ -0,0 +1,65 @@
+/*
+ * budget.h -- process-wide budget of interpreters for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_BUDGET_H
+#define WEB_BUDGET_H
+
+#include "tcl.h"
+
+/* ----------------------------------------------------------------------------
+ * the number of interps of the process is limited by WebshMaxInterps and
+ * per class id by the class option maxinterps. The free interps of all
+ * threads are kept in one LRU list. If a thread needs a new interp and
+ * the budget is used up, the least recently used free interp is marked
+ * evicted and no longer counted. Interps belong to their thread, so the
+ * owner destroys it the next time it looks at it (free list or reaper).
+ * Nothing is tracked until a budget is set.
+ * BudgetClass entries live until budgetFinalize, pointers are stable.
+ * ------------------------------------------------------------------------- */
+
+typedef struct BudgetClass
+{
+    char *classid;
+    long count;			/* interps counted for this class id */
+    long max;			/* 0: no limit */
+}
+BudgetClass;
+
+/* embedded in every WebInterp */
+typedef struct BudgetLink
+{
+    struct BudgetLink *prev;	/* LRU list of free interps */
+    struct BudgetLink *next;
+    BudgetClass *budgetClass;
+    int counted;		/* interp is counted */
+    int linked;			/* interp is in the LRU list */
+    int evicted;		/* owner has to destroy the interp */
+}
+BudgetLink;
+
+void budgetSetMax(long maxInterps);
+BudgetClass *budgetGetClass(const char *classid);
+void budgetSetClassMax(BudgetClass * budgetClass, long max);
+
+int budgetAdd(BudgetLink * link, BudgetClass * budgetClass, int evict);
+void budgetRemove(BudgetLink * link);
+void budgetPushFree(BudgetLink * link);
+int budgetTakeFree(BudgetLink * link);
+int budgetTake(BudgetLink * link);
+int budgetEvicted(BudgetLink * link);
+
+void budgetFinalize(void);
+
+#endif
@@ -142,6 +142,12 @@ int Web_Cfg(ClientData clientData, Tcl_Interp * interp,
 	"document_root",
 	"interpclass",
 	"filepermissions",
+	"putxcache",
+	"putxfilecheck",
+	"putxvars",
+	"outputbuffer",
+	"compression",
+	"compressminsize",
 	NULL
     };
 
@@ -163,7 +169,13 @@ int Web_Cfg(ClientData clientData, Tcl_Interp * interp,
 	SERVER_ROOT,
 	DOCUMENT_ROOT,
 	INTERPCLASS,
-	FILEPERMISSIONS
+	FILEPERMISSIONS,
+	PUTXCACHE,
+	PUTXFILECHECK,
+	PUTXVARS,
+	OUTPUTBUFFER,
+	COMPRESSION,
+	COMPRESSMINSIZE
     };
 
     int idx1, result;
@@ -414,6 +426,154 @@ int Web_Cfg(ClientData clientData, Tcl_Interp * interp,
 	    Tcl_SetObjResult(interp, value);
 	    return TCL_OK;
 	}
+    case PUTXCACHE:{
+
+	    int tmpInt = -1;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewIntObj(cfgData->outData->putxCacheSize));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetIntFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		if (tmpInt < 0)
+		    tmpInt = 0;
+		/* cached scripts are dropped, e.g. to free their memory */
+		webout_clear_cache(cfgData->outData);
+		cfgData->outData->putxCacheSize = tmpInt;
+		return TCL_OK;
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config putxcache", WEBLOG_INFO,
+			"usage: web::config putxcache ?size?", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    case PUTXFILECHECK:{
+
+	    int tmpInt = -1;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewIntObj(cfgData->outData->putxFileCheck));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetIntFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		if (tmpInt < 0)
+		    tmpInt = 0;
+		cfgData->outData->putxFileCheck = tmpInt;
+		return TCL_OK;
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config putxfilecheck", WEBLOG_INFO,
+			"usage: web::config putxfilecheck ?seconds?", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    case PUTXVARS:{
+
+	    int tmpInt = 0;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewBooleanObj(cfgData->outData->putxVars));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetBooleanFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		/* templates are compiled for one setting */
+		if (tmpInt != cfgData->outData->putxVars)
+		    webout_clear_cache(cfgData->outData);
+		cfgData->outData->putxVars = tmpInt;
+		return TCL_OK;
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config putxvars", WEBLOG_INFO,
+			"usage: web::config putxvars ?boolean?", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    case OUTPUTBUFFER:{
+
+	    int tmpInt = -1;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewIntObj(cfgData->outData->outputBuffer));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetIntFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		/* what is buffered is written first */
+		return setOutputBuffer(interp, cfgData->outData, tmpInt);
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config outputbuffer", WEBLOG_INFO,
+			"usage: web::config outputbuffer ?size?", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    case COMPRESSION:{
+
+	    int tmpInt = -1;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewIntObj(cfgData->outData->compression));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetIntFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		return setOutputCompression(interp, cfgData->outData, tmpInt,
+					    cfgData->outData->compressMinSize);
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config compression", WEBLOG_INFO,
+			"usage: web::config compression ?level?", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    case COMPRESSMINSIZE:{
+
+	    int tmpInt = -1;
+
+	    Tcl_SetObjResult(interp,
+			     Tcl_NewIntObj(cfgData->outData->compressMinSize));
+
+	    switch (objc) {
+	    case 2:
+		return TCL_OK;
+	    case 3:
+		if (Tcl_GetIntFromObj(interp, objv[2], &tmpInt) == TCL_ERROR)
+		    return TCL_ERROR;
+		return setOutputCompression(interp, cfgData->outData,
+					    cfgData->outData->compression,
+					    tmpInt);
+	    default:
+		LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+			__FILE__, __LINE__,
+			"web::config compressminsize", WEBLOG_INFO,
+			"usage: web::config compressminsize ?size?", NULL);
+		return TCL_ERROR;
+	    }
+	}
     case LOGSUBST:
 	Tcl_SetObjResult(interp,
 			 Tcl_NewBooleanObj(cfgData->logData->logSubst));
@@ -534,6 +694,14 @@ int Web_Cfg(ClientData clientData, Tcl_Interp * interp,
 	Tcl_SetBooleanObj(cfgData->requestData->cmdUrlTimestamp, 1);
 
 	cfgData->outData->putxMarkup = PUTXMARKUPDEFAULT;
+	cfgData->outData->putxCacheSize = PUTXCACHEDEFAULT;
+	cfgData->outData->putxFileCheck = PUTXFILECHECKDEFAULT;
+	if (cfgData->outData->putxVars != PUTXVARSDEFAULT)
+	    webout_clear_cache(cfgData->outData);
+	cfgData->outData->putxVars = PUTXVARSDEFAULT;
+	setOutputBuffer(interp, cfgData->outData, OUTPUTBUFFERDEFAULT);
+	setOutputCompression(interp, cfgData->outData, COMPRESSIONDEFAULT,
+			     COMPRESSMINSIZEDEFAULT);
 
 	cryptData = cfgData->cryptData;
 	tmp = Tcl_NewStringObj(WEBSH_CONFIG_DEFAULT_ENCRYPT, -1);
@@ -33,11 +33,6 @@
  * ------------------------------------------------------------------------- */
 #define WEB_CONV_HTMLIFY_SWITCH_NUMERIC "-numeric"
 
-/* --------------------------------------------------------------------------
- * Registered Data (SetAssocData) 
- * ------------------------------------------------------------------------*/
-#define WEB_CONV_ASSOC_DATA "web::conv"
-
 /* --------------------------------------------------------------------------
  * Internas
  * ------------------------------------------------------------------------*/
@@ -45,19 +40,6 @@
 
 #define WEBENC_LATIN_TABLE_LENGTH 256
 
-/* ----------------------------------------------------------------------------
- * internal data
- * ------------------------------------------------------------------------- */
-typedef struct ConvData
-{
-    int need[WEBENC_LATIN_TABLE_LENGTH];
-    Tcl_Obj *ute[WEBENC_LATIN_TABLE_LENGTH];	/* ">" --> "gt" */
-    Tcl_HashTable *etu;		/* "gt" --> ">" */
-}
-ConvData;
-ConvData *createConvData();
-void destroyConvData(ClientData clientData, Tcl_Interp * interp);
-
 /* ----------------------------------------------------------------------------
  * Tcl interface
  * ------------------------------------------------------------------------- */
@@ -76,8 +58,8 @@ int Web_DeHtmlify(ClientData clientData,
 
 void htmlifyAppendNum(Tcl_Obj * tclo, int num);
 
-Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric);
-int webDeHtmlify(ConvData * convData, Tcl_Obj * in, Tcl_Obj * out);
+Tcl_Obj *webHtmlify(Tcl_Obj * in, int useNumeric);
+int webDeHtmlify(Tcl_Obj * in, Tcl_Obj * out);
 
 Tcl_Obj *uriEncode(Tcl_Obj * inString);
 Tcl_Obj *uriDecode(Tcl_Obj * inString);
@@ -89,7 +71,6 @@ Tcl_Obj *uriDecode(Tcl_Obj * inString);
 int removeHtmlComments(Tcl_Interp * interp, Tcl_Obj * in, Tcl_Obj * res);
 int removeShortHtmlComments(Tcl_Obj * in, Tcl_Obj * res);
 int removeHtmlTags(Tcl_Obj * in, Tcl_Obj * res);
-int convertHtmlEntities(ConvData * convData, Tcl_Obj * in, Tcl_Obj * res);
 Tcl_UniChar getNumericEntity(Tcl_UniChar ** str, int len);
 int Web_Html_RemoveComments(ClientData clientData,
 			    Tcl_Interp * interp,
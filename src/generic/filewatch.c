@@ -0,0 +1,408 @@
+/*
+ * filewatch.c -- process-wide watcher for script files of mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include "filewatch.h"
+
+#ifdef __linux__
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include "hashutl.h"
+#include "macros.h"
+#include "srccache.h"
+#include "webutl.h"
+
+/* changes we react on, for files in a watched directory */
+#define FILEWATCH_DIR_EVENTS (IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE \
+	| IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+	| IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/* written by the watcher thread, read without lock by request threads:
+   generation is bumped before the epoch, readers load the epoch first */
+#define FILEWATCH_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define FILEWATCH_BUMP(x) __atomic_add_fetch(&(x), 1, __ATOMIC_RELEASE)
+
+static Tcl_HashTable *watchFiles = NULL;	/* path -> FileWatch */
+static Tcl_HashTable *watchDirs = NULL;	/* wd -> directory (char *) */
+static int watchFd = -1;
+static int wakeFd[2] = { -1, -1 };
+static Tcl_ThreadId watchThread;
+static int watchRunning = 0;
+static long watchEpoch = 0;
+TCL_DECLARE_MUTEX(fileWatchLock)
+
+/* ----------------------------------------------------------------------------
+ * bumpFileWatch -- record a change of fileWatch (locked)
+ * ------------------------------------------------------------------------- */
+static void bumpFileWatch(FileWatch * fileWatch)
+{
+    FILEWATCH_BUMP(fileWatch->generation);
+    /* the cached source might be of the same second and size */
+    sourceCacheFlush(fileWatch->filename);
+}
+
+/* ----------------------------------------------------------------------------
+ * bumpAllFileWatches -- events were lost (locked)
+ * ------------------------------------------------------------------------- */
+static void bumpAllFileWatches(void)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+
+    for (hashEntry = Tcl_FirstHashEntry(watchFiles, &search);
+	 hashEntry != NULL; hashEntry = Tcl_NextHashEntry(&search))
+	bumpFileWatch((FileWatch *) Tcl_GetHashValue(hashEntry));
+}
+
+/* ----------------------------------------------------------------------------
+ * unwatchDir -- the watch wd is gone or useless: its files are changed and
+ * wait for fileWatchAdd to watch their directory again (locked)
+ * ------------------------------------------------------------------------- */
+static void unwatchDir(int wd)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+    FileWatch *fileWatch;
+
+    hashEntry = Tcl_FindHashEntry(watchDirs, (char *) (long) wd);
+    if (hashEntry != NULL) {
+	Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+	Tcl_DeleteHashEntry(hashEntry);
+    }
+    for (hashEntry = Tcl_FirstHashEntry(watchFiles, &search);
+	 hashEntry != NULL; hashEntry = Tcl_NextHashEntry(&search)) {
+	fileWatch = (FileWatch *) Tcl_GetHashValue(hashEntry);
+	if (fileWatch->wd == wd) {
+	    fileWatch->wd = -1;
+	    bumpFileWatch(fileWatch);
+	}
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * watchDir -- watch the directory of filename, returns the watch or -1
+ * (locked)
+ * ------------------------------------------------------------------------- */
+static int watchDir(const char *filename)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_DString dir;
+    const char *slash;
+    int isNew = 0;
+    int wd;
+
+    slash = strrchr(filename, '/');
+    Tcl_DStringInit(&dir);
+    if (slash == filename)
+	Tcl_DStringAppend(&dir, "/", 1);
+    else
+	Tcl_DStringAppend(&dir, filename, (int) (slash - filename));
+
+    wd = inotify_add_watch(watchFd, Tcl_DStringValue(&dir),
+			   FILEWATCH_DIR_EVENTS);
+    if (wd >= 0) {
+	hashEntry = Tcl_CreateHashEntry(watchDirs, (char *) (long) wd, &isNew);
+	if (isNew) {
+	    /* the directory is the prefix for the names of events,
+	       "/" has to become "" */
+	    if (slash == filename)
+		Tcl_DStringSetLength(&dir, 0);
+	    Tcl_SetHashValue(hashEntry,
+			     (ClientData) allocAndSet(Tcl_DStringValue(&dir)));
+	}
+    }
+    Tcl_DStringFree(&dir);
+
+    return wd < 0 ? -1 : wd;
+}
+
+/* ----------------------------------------------------------------------------
+ * handleFileWatchEvent
+ * ------------------------------------------------------------------------- */
+static void handleFileWatchEvent(struct inotify_event *event)
+{
+    Tcl_HashEntry *hashEntry;
+
+    Tcl_MutexLock(&fileWatchLock);
+
+    if (event->mask & IN_Q_OVERFLOW) {
+	bumpAllFileWatches();
+    } else if (event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+	/* directory was removed (or unwatched below), its watch is gone */
+	unwatchDir(event->wd);
+    } else if (event->mask & IN_MOVE_SELF) {
+	/* the watch follows the directory, not its path: drop it */
+	inotify_rm_watch(watchFd, event->wd);
+	unwatchDir(event->wd);
+    } else if (event->len > 0) {
+	hashEntry = Tcl_FindHashEntry(watchDirs, (char *) (long) event->wd);
+	if (hashEntry != NULL) {
+	    Tcl_DString path;
+
+	    Tcl_DStringInit(&path);
+	    Tcl_DStringAppend(&path, (char *) Tcl_GetHashValue(hashEntry), -1);
+	    Tcl_DStringAppend(&path, "/", 1);
+	    Tcl_DStringAppend(&path, event->name, -1);
+	    hashEntry = Tcl_FindHashEntry(watchFiles, Tcl_DStringValue(&path));
+	    if (hashEntry != NULL)
+		bumpFileWatch((FileWatch *) Tcl_GetHashValue(hashEntry));
+	    Tcl_DStringFree(&path);
+	} else {
+	    hashEntry = NULL;
+	}
+	if (hashEntry == NULL) {
+	    /* not one of ours: no need to move the epoch */
+	    Tcl_MutexUnlock(&fileWatchLock);
+	    return;
+	}
+    }
+
+    FILEWATCH_BUMP(watchEpoch);
+
+    Tcl_MutexUnlock(&fileWatchLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchThread -- reads inotify events until woken up by finalize
+ * ------------------------------------------------------------------------- */
+static Tcl_ThreadCreateType fileWatchThread(ClientData clientData)
+{
+    char buf[4096]
+	__attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2];
+    ssize_t length;
+    char *ptr;
+
+    fds[0].fd = watchFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFd[0];
+    fds[1].events = POLLIN;
+
+    for (;;) {
+	fds[0].revents = fds[1].revents = 0;
+	if (poll(fds, 2, -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	if (fds[1].revents)
+	    break;
+	length = read(watchFd, buf, sizeof(buf));
+	if (length <= 0) {
+	    if (length < 0 && (errno == EINTR || errno == EAGAIN))
+		continue;
+	    break;
+	}
+	for (ptr = buf; ptr < buf + length;) {
+	    struct inotify_event *event = (struct inotify_event *) ptr;
+	    handleFileWatchEvent(event);
+	    ptr += sizeof(struct inotify_event) + event->len;
+	}
+    }
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchInit -- start the watcher, returns 1 if files can be watched
+ * ------------------------------------------------------------------------- */
+int fileWatchInit(void)
+{
+    int ok = 0;
+
+    Tcl_MutexLock(&fileWatchLock);
+
+    if (watchFd >= 0) {
+	Tcl_MutexUnlock(&fileWatchLock);
+	return 1;
+    }
+
+    watchFd = inotify_init();
+    if (watchFd >= 0 && pipe(wakeFd) == 0) {
+	fcntl(watchFd, F_SETFD, FD_CLOEXEC);
+	fcntl(wakeFd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(wakeFd[1], F_SETFD, FD_CLOEXEC);
+	HashUtlAllocInit(watchFiles, TCL_STRING_KEYS);
+	HashUtlAllocInit(watchDirs, TCL_ONE_WORD_KEYS);
+	if (Tcl_CreateThread(&watchThread, fileWatchThread, NULL,
+			     TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) == TCL_OK)
+	    ok = watchRunning = 1;
+    }
+
+    Tcl_MutexUnlock(&fileWatchLock);
+
+    if (!ok)
+	fileWatchFinalize();
+
+    return ok;
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchActive
+ * ------------------------------------------------------------------------- */
+int fileWatchActive(void)
+{
+    return watchFd >= 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchAdd -- watch filename (absolute path). Returns NULL if there is
+ * no watcher or the directory of the file can not be watched (e.g. it
+ * was removed and is not there again yet).
+ * ------------------------------------------------------------------------- */
+FileWatch *fileWatchAdd(const char *filename)
+{
+    Tcl_HashEntry *hashEntry;
+    FileWatch *fileWatch = NULL;
+    int isNew = 0;
+
+    if (watchFd < 0 || filename == NULL || filename[0] != '/')
+	return NULL;
+
+    Tcl_MutexLock(&fileWatchLock);
+
+    if (watchFiles == NULL) {
+	Tcl_MutexUnlock(&fileWatchLock);
+	return NULL;
+    }
+
+    hashEntry = Tcl_FindHashEntry(watchFiles, filename);
+    if (hashEntry != NULL) {
+	fileWatch = (FileWatch *) Tcl_GetHashValue(hashEntry);
+	/* its directory went away: watch the one there is now */
+	if (fileWatch->wd < 0) {
+	    fileWatch->wd = watchDir(filename);
+	    if (fileWatch->wd < 0)
+		fileWatch = NULL;
+	}
+    } else {
+	/* watch the directory: editors replace files by renaming */
+	int wd = watchDir(filename);
+
+	if (wd >= 0) {
+	    fileWatch = WebAllocInternalData(FileWatch);
+	    fileWatch->filename = allocAndSet(filename);
+	    fileWatch->generation = 0;
+	    fileWatch->wd = wd;
+	    hashEntry = Tcl_CreateHashEntry(watchFiles, filename, &isNew);
+	    Tcl_SetHashValue(hashEntry, (ClientData) fileWatch);
+	}
+    }
+
+    Tcl_MutexUnlock(&fileWatchLock);
+
+    return fileWatch;
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchGeneration, fileWatchEpoch -- no lock, see FILEWATCH_LOAD
+ * ------------------------------------------------------------------------- */
+long fileWatchGeneration(FileWatch * fileWatch)
+{
+    return FILEWATCH_LOAD(fileWatch->generation);
+}
+
+long fileWatchEpoch(void)
+{
+    return FILEWATCH_LOAD(watchEpoch);
+}
+
+/* ----------------------------------------------------------------------------
+ * fileWatchFinalize -- stop the watcher and forget all files
+ * ------------------------------------------------------------------------- */
+void fileWatchFinalize(void)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+    int result;
+
+    if (watchRunning) {
+	/* the thread exits on the first byte */
+	if (write(wakeFd[1], "x", 1) == 1)
+	    Tcl_JoinThread(watchThread, &result);
+	watchRunning = 0;
+    }
+
+    Tcl_MutexLock(&fileWatchLock);
+
+    if (watchFiles != NULL) {
+	for (hashEntry = Tcl_FirstHashEntry(watchFiles, &search);
+	     hashEntry != NULL; hashEntry = Tcl_NextHashEntry(&search)) {
+	    FileWatch *fileWatch = (FileWatch *) Tcl_GetHashValue(hashEntry);
+	    Tcl_Free(fileWatch->filename);
+	    Tcl_Free((char *) fileWatch);
+	}
+	HashUtlDelFree(watchFiles);
+	watchFiles = NULL;
+    }
+    if (watchDirs != NULL) {
+	for (hashEntry = Tcl_FirstHashEntry(watchDirs, &search);
+	     hashEntry != NULL; hashEntry = Tcl_NextHashEntry(&search))
+	    Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+	HashUtlDelFree(watchDirs);
+	watchDirs = NULL;
+    }
+    if (watchFd >= 0) {
+	close(watchFd);
+	watchFd = -1;
+    }
+    if (wakeFd[0] >= 0) {
+	close(wakeFd[0]);
+	close(wakeFd[1]);
+	wakeFd[0] = wakeFd[1] = -1;
+    }
+
+    Tcl_MutexUnlock(&fileWatchLock);
+}
+
+#else /* __linux__ */
+
+/* no watcher: classes compare the mtime on every request */
+
+int fileWatchInit(void)
+{
+    return 0;
+}
+
+int fileWatchActive(void)
+{
+    return 0;
+}
+
+FileWatch *fileWatchAdd(const char *filename)
+{
+    return NULL;
+}
+
+long fileWatchGeneration(FileWatch * fileWatch)
+{
+    return 0;
+}
+
+long fileWatchEpoch(void)
+{
+    return 0;
+}
+
+void fileWatchFinalize(void)
+{
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,48 @@
+/*
+ * filewatch.h -- process-wide watcher for script files of mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_FILEWATCH_H
+#define WEB_FILEWATCH_H
+
+#include "tcl.h"
+
+/* ----------------------------------------------------------------------------
+ * one watcher thread per process (Linux: inotify on the directories of the
+ * watched files). For every watched file there is a FileWatch whose
+ * generation is incremented on each change. The epoch is incremented on
+ * every change of any watched file, so a class only has to look at its
+ * files if the epoch moved since it last looked.
+ * FileWatch entries live until fileWatchFinalize, pointers are stable.
+ * If the directory of a file is removed or moved, the file counts as
+ * changed and fileWatchAdd watches the directory at its path again.
+ * Without a watcher, fileWatchAdd returns NULL and callers poll.
+ * ------------------------------------------------------------------------- */
+
+typedef struct FileWatch
+{
+    char *filename;		/* absolute path of the file */
+    long generation;		/* incremented on each change of the file */
+    int wd;			/* watch of its directory, -1: none */
+}
+FileWatch;
+
+int fileWatchInit(void);
+int fileWatchActive(void);
+FileWatch *fileWatchAdd(const char *filename);
+long fileWatchGeneration(FileWatch * fileWatch);
+long fileWatchEpoch(void);
+void fileWatchFinalize(void);
+
+#endif
@@ -20,6 +20,139 @@
 #include "conv.h"
 #include "log.h"
 
+/* ----------------------------------------------------------------------------
+ * HTML entities of ISO-8859-1 -- const, shared by all interps and threads
+ *
+ * entityTable is a minimal perfect hash of the entity names (hash and
+ * displace): the bucket entityHash(name, 0) % WEB_ENTITY_BUCKETS holds the
+ * seed that maps every name of the bucket to a slot of its own with
+ * entityHash(name, seed) % WEB_ENTITY_SLOTS. The seeds were found by trying
+ * 1, 2, ... for the buckets, largest bucket first; they must be searched
+ * again when a name is added. tests/htmlify.test (htmlify-2.3, 2.4) looks
+ * up every name.
+ *
+ * nbsp is the exception: nbsp --> 32, but 32 --> " " and 160 --> nbsp.
+ * hibar is accepted for 175, but macr is written.
+ * ------------------------------------------------------------------------- */
+#define WEB_ENTITY_BUCKETS 40
+#define WEB_ENTITY_SLOTS 101
+#define WEB_ENTITY_MAXLEN 6
+
+typedef struct ConvEntity
+{
+    const char *name;
+    int num;
+}
+ConvEntity;
+
+static const unsigned char entityDisplace[WEB_ENTITY_BUCKETS] = {
+    1, 2, 1, 1, 10, 4, 14, 10, 10, 8, 1, 35, 6, 5, 10, 5, 4, 2, 3, 49,
+    43, 11, 3, 1, 1, 30, 19, 11, 49, 34, 8, 66, 78, 30, 1, 77, 5, 10, 1, 190
+};
+
+static const ConvEntity entityTable[WEB_ENTITY_SLOTS] = {
+    {"sup2", 178}, {"pound", 163}, {"aacute", 225}, {"quot", 34},
+    {"lt", 60}, {"frac34", 190}, {"aring", 229}, {"Ugrave", 217},
+    {"ocirc", 244}, {"yacute", 253}, {"igrave", 236}, {"sup3", 179},
+    {"oslash", 248}, {"Iacute", 205}, {"acute", 180}, {"nbsp", 32},
+    {"hibar", 175}, {"atilde", 227}, {"deg", 176}, {"iacute", 237},
+    {"Ocirc", 212}, {"Igrave", 204}, {"Oslash", 216}, {"plusmn", 177},
+    {"Uacute", 218}, {"macr", 175}, {"micro", 181}, {"ograve", 242},
+    {"Oacute", 211}, {"uacute", 250}, {"Ccedil", 199}, {"para", 182},
+    {"yen", 165}, {"ccedil", 231}, {"frac14", 188}, {"amp", 38},
+    {"auml", 228}, {"sup1", 185}, {"brvbar", 166}, {"ordm", 186},
+    {"AElig", 198}, {"szlig", 223}, {"Ucirc", 219}, {"euml", 235},
+    {"laquo", 171}, {"agrave", 224}, {"oacute", 243}, {"yuml", 255},
+    {"sect", 167}, {"Aacute", 193}, {"Ntilde", 209}, {"divide", 247},
+    {"otilde", 245}, {"raquo", 187}, {"uml", 168}, {"eacute", 233},
+    {"Ouml", 214}, {"iexcl", 161}, {"icirc", 238}, {"eth", 240},
+    {"ecirc", 234}, {"iuml", 239}, {"times", 215}, {"uuml", 252},
+    {"middot", 183}, {"Yacute", 221}, {"Euml", 203}, {"ucirc", 251},
+    {"Uuml", 220}, {"Acirc", 194}, {"Iuml", 207}, {"Ograve", 210},
+    {"Icirc", 206}, {"Agrave", 192}, {"ETH", 208}, {"acirc", 226},
+    {"curren", 164}, {"ordf", 170}, {"cent", 162}, {"cedil", 184},
+    {"ouml", 246}, {"iquest", 191}, {"gt", 62}, {"Eacute", 201},
+    {"Otilde", 213}, {"Egrave", 200}, {"ugrave", 249}, {"ntilde", 241},
+    {"not", 172}, {"reg", 174}, {"shy", 173}, {"THORN", 222},
+    {"Aring", 197}, {"frac12", 189}, {"aelig", 230}, {"thorn", 254},
+    {"egrave", 232}, {"copy", 169}, {"Atilde", 195}, {"Auml", 196},
+    {"Ecirc", 202}
+};
+
+static const char *const uteTable[WEBENC_LATIN_TABLE_LENGTH] = {
+    /*   0 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*   8 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  16 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  24 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  32 */ NULL, NULL, "quot", NULL, NULL, NULL, "amp", NULL,
+    /*  40 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  48 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  56 */ NULL, NULL, NULL, NULL, "lt", NULL, "gt", NULL,
+    /*  64 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  72 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  80 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  88 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /*  96 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 104 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 112 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 120 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 128 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 136 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 144 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 152 */ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    /* 160 */ "nbsp", "iexcl", "cent", "pound", "curren", "yen", "brvbar", "sect",
+    /* 168 */ "uml", "copy", "ordf", "laquo", "not", "shy", "reg", "macr",
+    /* 176 */ "deg", "plusmn", "sup2", "sup3", "acute", "micro", "para", "middot",
+    /* 184 */ "cedil", "sup1", "ordm", "raquo", "frac14", "frac12", "frac34", "iquest",
+    /* 192 */ "Agrave", "Aacute", "Acirc", "Atilde", "Auml", "Aring", "AElig", "Ccedil",
+    /* 200 */ "Egrave", "Eacute", "Ecirc", "Euml", "Igrave", "Iacute", "Icirc", "Iuml",
+    /* 208 */ "ETH", "Ntilde", "Ograve", "Oacute", "Ocirc", "Otilde", "Ouml", "times",
+    /* 216 */ "Oslash", "Ugrave", "Uacute", "Ucirc", "Uuml", "Yacute", "THORN", "szlig",
+    /* 224 */ "agrave", "aacute", "acirc", "atilde", "auml", "aring", "aelig", "ccedil",
+    /* 232 */ "egrave", "eacute", "ecirc", "euml", "igrave", "iacute", "icirc", "iuml",
+    /* 240 */ "eth", "ntilde", "ograve", "oacute", "ocirc", "otilde", "ouml", "divide",
+    /* 248 */ "oslash", "ugrave", "uacute", "ucirc", "uuml", "yacute", "thorn", "yuml"
+};
+
+/* FNV-1a */
+static unsigned int entityHash(const char *name, int len, unsigned int seed)
+{
+    unsigned int hash = 2166136261U ^ seed;
+    int i;
+
+    for (i = 0; i < len; i++) {
+	hash ^= (unsigned char) name[i];
+	hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* ----------------------------------------------------------------------------
+ * entityLookup -- character of the entity name (without & and ;), or -1
+ * ------------------------------------------------------------------------- */
+static int entityLookup(const Tcl_UniChar * name, int len)
+{
+    char key[WEB_ENTITY_MAXLEN + 1];
+    const ConvEntity *entry;
+    unsigned int seed;
+    int i;
+
+    if (len <= 0 || len > WEB_ENTITY_MAXLEN)
+	return -1;
+
+    for (i = 0; i < len; i++) {
+	if (name[i] == 0 || name[i] > 127)
+	    return -1;
+	key[i] = (char) name[i];
+    }
+    key[len] = 0;
+
+    seed = entityDisplace[entityHash(key, len, 0) % WEB_ENTITY_BUCKETS];
+    entry = &entityTable[entityHash(key, len, seed) % WEB_ENTITY_SLOTS];
+
+    return strcmp(entry->name, key) ? -1 : entry->num;
+}
+
 /* ----------------------------------------------------------------------------
  * htmlifyAppendNum
  * ------------------------------------------------------------------------- */
@@ -46,16 +179,16 @@ void htmlifyAppendNum(Tcl_Obj * tclo, int num)
 /* ----------------------------------------------------------------------------
  * webHtmlify -- convert string from ISO-8859-1 to HTML
  * ------------------------------------------------------------------------- */
-Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
+Tcl_Obj *webHtmlify(Tcl_Obj * in, int useNumeric)
 {
 
     int iPos = 0;
     int len = 0;
     Tcl_UniChar unic = 0;
-    Tcl_Obj *entity = NULL;
+    const char *entity = NULL;
     Tcl_Obj *res = NULL;
 
-    if ((convData == NULL) || (in == NULL))
+    if (in == NULL)
 	return NULL;
 
     res = Tcl_NewObj();
@@ -76,8 +209,7 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
 	/* --------------------------------------------------------------------
 	 * translation needed ?
 	 * ----------------------------------------------------------------- */
-	if (unic <= WEBENC_LATIN_TABLE_LENGTH &&
-	    convData->need[unic] == TCL_OK) {
+	if (unic < WEBENC_LATIN_TABLE_LENGTH && uteTable[unic] != NULL) {
 
 	    /* yes */
 
@@ -90,21 +222,15 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
 
 		/* no, entity */
 
-		entity = convData->ute[unic];
-
-		if (entity == NULL) {
-		    htmlifyAppendNum(res, unic);
-		}
-		else {
+		entity = uteTable[unic];
 
-		    Tcl_AppendToObj(res, "&", 1);
-		    Tcl_AppendObjToObj(res, entity);
-		    Tcl_AppendToObj(res, ";", 1);
-		}
+		Tcl_AppendToObj(res, "&", 1);
+		Tcl_AppendToObj(res, entity, -1);
+		Tcl_AppendToObj(res, ";", 1);
 	    }
 	}
 	else {
-	  if (unic > WEBENC_LATIN_TABLE_LENGTH) {
+	  if (unic >= WEBENC_LATIN_TABLE_LENGTH) {
 	    /* numeric translation, because there is no entity 
 	       for characters > 256 (multibyte character sets */
 	    htmlifyAppendNum(res, unic);
@@ -161,7 +287,7 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
   } \
 }
 
-#define HANDLE_ENTITY(convData, unic, length, out, pos, err) { \
+#define HANDLE_ENTITY(unic, length, out, pos, err) { \
   int begin = pos; \
   int end = ++pos; \
   int first = end; \
@@ -203,7 +329,7 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
       /* a number */ \
       HANDLE_UNICODE_ENTITY(unic, length, out, begin, first, end, err); \
     } else { \
-      HANDLE_KEY_ENTITY(convData, unic, length, out, begin, first, end, err); \
+      HANDLE_KEY_ENTITY(unic, length, out, begin, first, end, err); \
     } \
   } \
 }
@@ -236,25 +362,14 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
   Tcl_DecrRefCount(entity); \
 }
 
-#define HANDLE_KEY_ENTITY(convData, unic, length, out, begin, first, end, err) { \
+#define HANDLE_KEY_ENTITY(unic, length, out, begin, first, end, err) { \
   /* use lookup table */ \
-  Tcl_Obj* iObj = NULL; \
-  Tcl_Obj* entity = Tcl_NewUnicodeObj(&(unic[first]),end-first); \
-  Tcl_IncrRefCount(entity); \
-  iObj   = (Tcl_Obj *)getFromHashTable(convData->etu, \
-				      Tcl_GetString(entity)); \
-  Tcl_DecrRefCount(entity); \
+  int tInt = entityLookup(&(unic[first]),end-first); \
    \
-  if( iObj != NULL ) { \
+  if( tInt >= 0 ) { \
     /* got it in table */ \
-    int tInt = 0; \
-    if( Tcl_GetIntFromObj(NULL,iObj,&tInt) != TCL_ERROR ) { \
-      Tcl_UniChar tmp = (Tcl_UniChar) tInt; \
-      Tcl_AppendUnicodeToObj(out,&tmp,1); \
-      /* don't kill iObj, it's owned by the hashtable */ \
-    } else { \
-      /* we do not have invalid values in the hashtable !*/ \
-    } \
+    Tcl_UniChar tmp = (Tcl_UniChar) tInt; \
+    Tcl_AppendUnicodeToObj(out,&tmp,1); \
   } else { \
     /* not in table, we write the string instead */ \
     Tcl_AppendUnicodeToObj(out,&(unic[begin]),end-begin); \
@@ -267,7 +382,7 @@ Tcl_Obj *webHtmlify(ConvData * convData, Tcl_Obj * in, int useNumeric)
 /* ----------------------------------------------------------------------------
  *  webDeHtmlify -- de-htmlifies input string 'in' and writes to 'out'
  * ------------------------------------------------------------------------- */
-int webDeHtmlify(ConvData * convData, Tcl_Obj * in, Tcl_Obj * out)
+int webDeHtmlify(Tcl_Obj * in, Tcl_Obj * out)
 {
 
     int length;			/* length of input */
@@ -330,7 +445,7 @@ int webDeHtmlify(ConvData * convData, Tcl_Obj * in, Tcl_Obj * out)
 	    /*
 	     * it's an entity
 	     */
-	    HANDLE_ENTITY(convData, unic, length, out, pos, err);
+	    HANDLE_ENTITY(unic, length, out, pos, err);
 	    plainfirst = pos + 1;
 	}
 
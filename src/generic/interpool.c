@@ -25,6 +25,9 @@
 #include "web.h"
 #include "mod_websh.h"
 #include "request.h"
+#include "srccache.h"
+#include "mapcache.h"
+#include "mainthread.h"
 #include <time.h>
 #include <sys/stat.h>
 #ifndef WIN32
@@ -41,6 +44,12 @@
 
 #include <tcl.h>
 #include <assert.h>
+#ifdef APACHE2
+#include "apr_strings.h"
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>		/* malloc_trim */
+#endif
 
 #define TCL_TSD_INIT(keyPtr) \
   ((ThreadSpecificData *)Tcl_GetThreadData((keyPtr), sizeof(ThreadSpecificData)))
@@ -49,6 +58,9 @@ typedef struct ThreadSpecificData {
     websh_server_conf *conf;
     Tcl_Interp        *mainInterp;
     WebshPool         *webshPool;
+    long               lastReap;	/* time of last reaper tick */
+    Tcl_HashTable     *mapCache;	/* filename -> class id, see mapcache.h */
+    long               mapGeneration;	/* generation of the shared map cache */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
@@ -56,7 +68,8 @@ static Tcl_ThreadDataKey dataKey;
 
 /* init script for main interpreter */
 
-#define MAININTERP_INITCODE "proc web::interpmap {filename} {return $filename}"
+#define MAININTERP_MAPBODY "return $filename"
+#define MAININTERP_INITCODE "proc web::interpmap {filename} {" MAININTERP_MAPBODY "}"
 
 #define WIP_CURRENT_THREAD 0
 #define WIP_CHECK_THREAD   1
@@ -89,12 +102,17 @@ static Tcl_ThreadDataKey dataKey;
   #define AP_LOG_RERROR(r, format, ...) ap_log_rerror(APLOG_MARK, APLOG_NOERRNO | APLOG_ERR, 0, r, format, ##__VA_ARGS__);
 #endif
 
+/* interps may be created outside of a request (prestart, refill) */
+#define AP_LOG_POOL_ERROR(conf, r, format, ...) \
+  if (r != NULL) { AP_LOG_RERROR(r, format, ##__VA_ARGS__); } \
+  else { AP_LOG_ERROR((conf)->server, format, ##__VA_ARGS__); }
+
 
 /* ----------------------------------------------------------------------------
  * Declaration
  * ------------------------------------------------------------------------- */
 
-static Tcl_Interp *createMainInterp(websh_server_conf * conf);
+static Tcl_Obj *mapWebInterpClass(char *filename, Tcl_Interp *mainInterp);
 static int initMainInterp(websh_server_conf * conf, Tcl_Interp *mainInterp);
 
 static WebInterp *poolCreateWebInterp(
@@ -113,18 +131,64 @@ static WebInterpClass *updateWebInterpClass(
 );
 
 
+static WebInterp *reloadWebInterpClass(websh_server_conf * conf,
+					WebInterpClass * webInterpClass,
+					request_rec *r);
+static void endWebInterpClassTrial(WebInterpClass *webInterpClass, int ok);
+
 static int readWebInterpClassCode(WebInterp *webInterp, char *filename, long mtime);
+static void addWebInterpClassDep(WebInterpClass *webInterpClass, const char *filename);
+static int Web_ApDepend(ClientData clientData, Tcl_Interp *interp,
+			int objc, Tcl_Obj *CONST objv[]);
 // static void deleteInterpClass(WebInterpClass * webInterpClass);
 
+static int reapPool(WebshPool *webshPool, apr_time_t deadline);
+
 
 /* ----------------------------------------------------------------------------
  * reserve/release WebInterp
  * ------------------------------------------------------------------------- */
 
+/* add the growth of the heap during the request to the interp */
+static void countWebInterpMemory(WebInterp *webInterp){
+    Tcl_WideInt inuse;
+
+    if (!webInterp->interpClass->maxmemory || webInterp->memoryMark < 0)
+	return;
+    if ((inuse = webHeapInUse()) < 0)
+	return;
+    webInterp->memory += inuse - webInterp->memoryMark;
+    if (webInterp->memory < 0)
+	webInterp->memory = 0;
+}
+
+/* add the wall time of the request that just finished to the counters */
+static void countWebInterpRequest(WebInterp *webInterp){
+    WebInterpClassStats *stats = &(webInterp->interpClass->stats);
+
+    stats->requests++;
+    if (webInterp->time_request > 0) {
+	Tcl_WideInt elapsed = (Tcl_WideInt) (apr_time_now() - webInterp->time_request);
+
+	webInterp->requesttime += elapsed;
+	stats->requesttime += elapsed;
+	if (webInterp->time_ready > webInterp->time_request)
+	    stats->readytime += webInterp->time_ready - webInterp->time_request;
+    }
+}
+
 static void reserveWebInterp(WebInterp *webInterp){
     if ( webInterp==NULL ) return;
 
+    unlinkFreeWebInterp(webInterp);
     webInterp->state = WIP_INUSE;
+
+    /* out of the LRU list, other threads must not evict it now */
+    if (!budgetTake(&(webInterp->budget))) {
+	logToAp(webInterp->interp, NULL,
+		"interpreter expired: evicted by interp budget (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	expireWebInterpFor(webInterp, WIP_EXPIRY_BUDGET);
+    }
 }
 
 static void releaseWebInterp(WebInterp *webInterp){
@@ -132,6 +196,11 @@ static void releaseWebInterp(WebInterp *webInterp){
 
     webInterp->lastusedtime = (long) time(NULL);
     webInterp->numrequests++;
+    countWebInterpRequest(webInterp);
+    countWebInterpMemory(webInterp);
+
+    if (webInterpClass->trialInterp == webInterp)
+	endWebInterpClassTrial(webInterpClass, !webInterp->initFailed);
 
     switch(webInterp->state){
 	case WIP_EXPIRED:
@@ -145,6 +214,12 @@ static void releaseWebInterp(WebInterp *webInterp){
 	    if (webInterpClass->maxrequests && (webInterp->numrequests >= webInterpClass->maxrequests)) {
 		logToAp(webInterp->interp, NULL,
 			"interpreter expired: request count reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+		webInterpClass->stats.expired[WIP_EXPIRY_REQUESTS]++;
+		webInterp->state = WIP_EXPIRED;
+	    } else if (webInterpClass->maxmemory && (webInterp->memory > (Tcl_WideInt) webInterpClass->maxmemory * 1024)) {
+		logToAp(webInterp->interp, NULL,
+			"interpreter expired: memory reached %ld kB (id %ld, class %s)", (long) (webInterp->memory / 1024), webInterp->id, webInterp->interpClass->filename);
+		webInterpClass->stats.expired[WIP_EXPIRY_MEMORY]++;
 		webInterp->state = WIP_EXPIRED;
 	    }
             break;
@@ -155,6 +230,8 @@ static void releaseWebInterp(WebInterp *webInterp){
 
     if( webInterp->state == WIP_EXPIRED ){
         poolDestroyWebInterp(webInterp, WIP_CURRENT_THREAD);
+    } else if( webInterp->state == WIP_FREE ){
+        pushFreeWebInterp(webInterp);
     }
 
     return;
@@ -165,47 +242,61 @@ static void releaseWebInterp(WebInterp *webInterp){
 /*
 *  WIP_FREE -> WIP_INUSE -> WIP_FREE -> WIP_EXPIRED
 *                        -> WIP_EXPIRED_INUSE
+*
+*  Pops the most recently released interp from the free list of the class.
+*  Interps found to be expired on the way are unlinked and marked
+*  WIP_EXPIRED (they are destroyed by the reaper).
 */
 static WebInterp *poolGetFreeWebInterp(WebInterpClass *webInterpClass)
 {
-    /* search a free interp */
-
-    if( webInterpClass->first == NULL) {
-      return NULL;
-    }
-
-    WebInterp *found = NULL;
+    WebInterp *webInterp, *nextFree;
     Tcl_ThreadId current_thread;
     time_t t;
 
     time(&t);
     current_thread = Tcl_GetCurrentThread();
 
-    WebInterp *webInterp;
-    for(webInterp = webInterpClass->first; webInterp != NULL; webInterp = webInterp->next) {
-	if (webInterp->originThrdId != current_thread) continue;  // check thread owner
+    /* the first interp of a new version gets the next request */
+    webInterp = webInterpClass->trialInterp;
+    if (webInterp != NULL && webInterp->state == WIP_FREE
+	&& webInterp->originThrdId == current_thread
+	&& budgetTakeFree(&(webInterp->budget)))
+	return webInterp;
+
+    webInterp = webInterpClass->freeFirst;
+    while (webInterp != NULL) {
+	nextFree = webInterp->nextFree;
+
+	/* only the shared pool holds interps of other threads, a thread
+	   specific pool always takes the first entry */
+	if (webInterp->originThrdId != current_thread) {
+	    webInterp = nextFree;
+	    continue;
+	}
 
-	if (webInterp->state == WIP_FREE) {
-            logToAp(webInterp->interp, NULL, "poolGetFreeWebInterp in current thread");
-	    if (webInterpClass->maxidletime && (t - webInterp->lastusedtime) > webInterpClass->maxidletime) {
-		logToAp(webInterp->interp, NULL,
-			"interpreter expired: idle time reached (id %ld, claa %s)", webInterp->id, webInterp->interpClass->filename);
-		webInterp->state = WIP_EXPIRED;
+	if (webInterpClass->maxidletime && (t - webInterp->lastusedtime) > webInterpClass->maxidletime) {
+	    logToAp(webInterp->interp, NULL,
+		    "interpreter expired: idle time reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	    expireWebInterpFor(webInterp, WIP_EXPIRY_IDLE);
 
-	    } else if (webInterpClass->maxttl && (t - webInterp->starttime) > webInterpClass->maxttl) {
-		logToAp(webInterp->interp, NULL,
-		        "interpreter expired: time to live reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
-		webInterp->state = WIP_EXPIRED;
-                logToAp(webInterp->interp, NULL, "poolGetFreeWebInterp mark WIP_EXPIRED due to maxttl");
-            } else {
-                logToAp(webInterp->interp, NULL, "poolGetFreeWebInterp found free WebInterp");
-	        found = webInterp;
-	        break;
-	    }
+	} else if (webInterpClass->maxttl && (t - webInterp->starttime) > webInterpClass->maxttl) {
+	    logToAp(webInterp->interp, NULL,
+		    "interpreter expired: time to live reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	    expireWebInterpFor(webInterp, WIP_EXPIRY_TTL);
+
+	} else if (!budgetTakeFree(&(webInterp->budget))) {
+	    logToAp(webInterp->interp, NULL,
+		    "interpreter expired: evicted by interp budget (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	    expireWebInterpFor(webInterp, WIP_EXPIRY_BUDGET);
+
+	} else {
+	    return webInterp;
 	}
+
+	webInterp = nextFree;
     }
 
-    return found;
+    return NULL;
 }
 
 /* ----------------------------------------------------------------------------
@@ -223,6 +314,20 @@ static WebInterp *poolGetFreeWebInterp(WebInterpClass *webInterpClass)
  * See http://www.tcl.tk/doc/howto/thread_model.html about it.
  * ------------------------------------------------------------------------- */
 
+/* ----------------------------------------------------------------------------
+ * clearThreadMapCache -- forget the class ids known by the thread
+ * ------------------------------------------------------------------------- */
+static void clearThreadMapCache(ThreadSpecificData *tsdPtr)
+{
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+
+    while ((entry = Tcl_FirstHashEntry(tsdPtr->mapCache, &search)) != NULL) {
+	Tcl_Free((char *) Tcl_GetHashValue(entry));
+	Tcl_DeleteHashEntry(entry);
+    }
+}
+
 static void initPoolThread(websh_server_conf * conf, apr_thread_t *current_thread)
 {
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
@@ -232,12 +337,30 @@ static void initPoolThread(websh_server_conf * conf, apr_thread_t *current_threa
     DEBUG_TRACE(conf->server, "initPoolThread");
 
     tsdPtr->conf = conf;
-    tsdPtr->mainInterp = createMainInterp(conf);
     HashUtlAllocInit(tsdPtr->webshPool, TCL_STRING_KEYS);
+    HashUtlAllocInit(tsdPtr->mapCache, TCL_STRING_KEYS);
+    tsdPtr->mapGeneration = mapCacheGeneration();
+    /* created on demand, see getThreadMainInterp */
+    tsdPtr->mainInterp = NULL;
 
     apr_thread_data_set(conf, "WebInterpThreadPool", destroyPoolThread, current_thread);
 }
 
+/* ----------------------------------------------------------------------------
+ * getThreadMainInterp -- main interp of the thread, created on first use.
+ * Only web::interpmap of the WebshConfig file needs it, class options of
+ * that file are taken from conf->classDefaults.
+ * ------------------------------------------------------------------------- */
+static Tcl_Interp *getThreadMainInterp(websh_server_conf *conf,
+				       ThreadSpecificData *tsdPtr)
+{
+    if (tsdPtr->mainInterp == NULL) {
+	DEBUG_TRACE(conf->server, "create main interp of thread");
+	tsdPtr->mainInterp = createMainInterp(conf, tsdPtr->webshPool);
+    }
+    return tsdPtr->mainInterp;
+}
+
 static apr_status_t destroyPoolThread(void *data)
 {
     websh_server_conf *conf = (websh_server_conf *) data;
@@ -266,37 +389,146 @@ static apr_status_t destroyPoolThread(void *data)
 
     Tcl_DeleteHashTable(tsdPtr->webshPool);
     tsdPtr->webshPool = NULL;
+
+    if (tsdPtr->mapCache != NULL) {
+	clearThreadMapCache(tsdPtr);
+	HashUtlDelFree(tsdPtr->mapCache);
+	tsdPtr->mapCache = NULL;
+    }
+
+    if (tsdPtr->mainInterp != NULL) {
+	Tcl_DeleteInterp(tsdPtr->mainInterp);
+	tsdPtr->mainInterp = NULL;
+    }
     DEBUG_TRACE(conf->server, "destroyPoolThread ok");
 
     return APR_SUCCESS;
 }
 
-WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
-			    long mtime, request_rec * r)
+/* ----------------------------------------------------------------------------
+ * getThreadWebInterpClassId -- id (= script) of the class for the requested
+ * file: the first matching WebshInterpMap rule, else web::interpmap of the
+ * main interp of the thread. Results are cached per thread and per process.
+ * ------------------------------------------------------------------------- */
+static char *getThreadWebInterpClassId(websh_server_conf *conf,
+				       ThreadSpecificData *tsdPtr,
+				       char *filename, request_rec *r)
 {
+    Tcl_HashEntry *entry;
+    long generation;
+    char *classid;
+    int isnew = 0;
+
+    /* read the generation before the shared cache, see mapCacheFlush */
+    generation = mapCacheGeneration();
+    if (generation != tsdPtr->mapGeneration
+	|| tsdPtr->mapCache->numEntries >= WEB_MAPCACHE_MAX) {
+	clearThreadMapCache(tsdPtr);
+	tsdPtr->mapGeneration = generation;
+    }
 
-    initPoolThread(conf, r->connection->current_thread);
+    entry = Tcl_FindHashEntry(tsdPtr->mapCache, filename);
+    if (entry != NULL)
+	return (char *) Tcl_GetHashValue(entry);
 
-    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    classid = mapCacheGet(filename);
 
-    WebInterpClass *webInterpClass;
-    WebInterp      *webInterp = NULL;
+    if (classid == NULL) {
+	const char *id = NULL;
+	Tcl_Obj *idObj = NULL;
 
-    webInterpClass = poolCreateWebInterpClass(conf, tsdPtr->webshPool, filename, mtime);
-    if(webInterpClass==NULL){
-       AP_LOG_ERROR(r->server, "cannot access or stat webInterpClass file '%s'", filename);
-       return NULL;
+	if (conf->interpMapRules != NULL) {
+	    websh_interpmap_rule *rules = (websh_interpmap_rule *) conf->interpMapRules->elts;
+	    int i;
+
+	    for (i = 0; i < conf->interpMapRules->nelts; i++) {
+		if (Tcl_StringMatch(filename, rules[i].pattern)) {
+		    id = rules[i].classid;
+		    break;
+		}
+	    }
+	}
+
+	/* the default web::interpmap maps a file to itself */
+	if (id == NULL && conf->customInterpMap) {
+	    Tcl_Interp *mainInterp = getThreadMainInterp(conf, tsdPtr);
+
+	    if (mainInterp != NULL) {
+		idObj = mapWebInterpClass(filename, mainInterp);
+		if (idObj == NULL) {
+		    AP_LOG_RERROR(r, "web::interpmap: %s", Tcl_GetStringResult(mainInterp));
+		    Tcl_ResetResult(mainInterp);
+		    return NULL;
+		}
+		id = ap_server_root_relative(r->pool, Tcl_GetString(idObj));
+	    }
+	}
+
+	classid = allocAndSet(id != NULL ? id : filename);
+	if (idObj != NULL)
+	    Tcl_DecrRefCount(idObj);
+
+	mapCachePut(filename, classid);
     }
 
-    AP_LOG_DEBUG(r->server, "use WebInterpClass maxrequests=%ld maxttl=%ld maxidletime=%ld mtime=%ld from %s",
-        webInterpClass->maxrequests, webInterpClass->maxttl, webInterpClass->maxidletime,
-        webInterpClass->mtime, webInterpClass->filename);
+    entry = Tcl_CreateHashEntry(tsdPtr->mapCache, filename, &isnew);
+    Tcl_SetHashValue(entry, (ClientData) classid);
+
+    return classid;
+}
+
+/* ----------------------------------------------------------------------------
+ * refuseRequest -- the class is overloaded: 503 with Retry-After
+ * ------------------------------------------------------------------------- */
+static void refuseRequest(WebInterpClass *webInterpClass, request_rec * r,
+			  AdmissionResult result, int *status)
+{
+    long retry = admissionGetLimit(webInterpClass->admission,
+				   ADMISSION_QUEUETIMEOUT) / 1000;
+
+    if (retry < 1)
+	retry = 1;
+
+    AP_LOG_RERROR(r, "mod_websh - class %s overloaded (%s), request refused",
+		  webInterpClass->filename,
+		  result == ADMISSION_FULL ? "queue full" : "queue timeout");
+
+    *status = HTTP_SERVICE_UNAVAILABLE;
+    apr_table_setn(r->err_headers_out, "Retry-After",
+		   apr_psprintf(r->pool, "%ld", retry));
+}
+
+/* ----------------------------------------------------------------------------
+ * acquireWebInterp -- free or new interp of the class, ready for r
+ * ------------------------------------------------------------------------- */
+static WebInterp *acquireWebInterp(websh_server_conf *conf,
+				   WebInterpClass *webInterpClass,
+				   char *filename, long mtime,
+				   request_rec * r, int *status)
+{
+    WebInterp *webInterp = NULL;
+    AdmissionResult result;
 
     webInterp = poolGetFreeWebInterp(webInterpClass);
 
-    if( webInterp==NULL ) {
-        AP_LOG_DEBUG(r->server, "create new WebInterp %ld %s", mtime, filename);
-	webInterp = poolCreateWebInterp(conf, webInterpClass, filename, mtime, r);
+    webInterpClass->stats.acquired++;
+    if (webInterp != NULL) {
+	webInterpClass->stats.hits++;
+    } else {
+	/* maxcreaterate */
+	result = admissionCreate(webInterpClass->admission);
+	if (result == ADMISSION_FULL || result == ADMISSION_TIMEOUT) {
+	    refuseRequest(webInterpClass, r, result, status);
+	    return NULL;
+	}
+	if (webInterpClass->reload && webInterpClass->trialInterp == NULL) {
+	    /* we have to wait for a new interp anyway, take the new code */
+	    webInterp = reloadWebInterpClass(conf, webInterpClass, r);
+	}
+	if (webInterp == NULL) {
+	    AP_LOG_DEBUG(r->server, "create new WebInterp %ld %s", mtime, filename);
+	    webInterp = poolCreateWebInterp(conf, webInterpClass, filename, mtime, r);
+	}
     }
 
     if (webInterp == NULL){
@@ -322,6 +554,62 @@ WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
 	return NULL;
     }
 
+    return webInterp;
+}
+
+/* ----------------------------------------------------------------------------
+ * poolGetThreadWebInterp -- interp for r. If there is none, returns NULL
+ * and the HTTP status of the request in status.
+ * ------------------------------------------------------------------------- */
+WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
+			    long mtime, request_rec * r, int *status)
+{
+
+    initPoolThread(conf, r->connection->current_thread);
+
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    WebInterpClass *webInterpClass;
+    WebInterp      *webInterp = NULL;
+    char           *classid;
+    AdmissionResult admitted;
+
+    *status = HTTP_INTERNAL_SERVER_ERROR;
+
+    classid = getThreadWebInterpClassId(conf, tsdPtr, filename, r);
+    if (classid == NULL) {
+	return NULL;
+    }
+    if (strcmp(classid, filename)) {
+	/* mtime of the request is not the one of the class script */
+	mtime = 0;
+	filename = classid;
+    }
+
+    webInterpClass = poolCreateWebInterpClass(conf, tsdPtr->webshPool, filename, mtime);
+    if(webInterpClass==NULL){
+       AP_LOG_ERROR(r->server, "cannot access or stat webInterpClass file '%s'", filename);
+       return NULL;
+    }
+
+    AP_LOG_DEBUG(r->server, "use WebInterpClass maxrequests=%ld maxttl=%ld maxidletime=%ld mtime=%ld from %s",
+        webInterpClass->maxrequests, webInterpClass->maxttl, webInterpClass->maxidletime,
+        webInterpClass->mtime, webInterpClass->filename);
+
+    /* maxconcurrent, may wait in the queue of the class */
+    admitted = admissionEnter(webInterpClass->admission);
+    if (admitted == ADMISSION_FULL || admitted == ADMISSION_TIMEOUT) {
+	refuseRequest(webInterpClass, r, admitted, status);
+	return NULL;
+    }
+
+    webInterp = acquireWebInterp(conf, webInterpClass, filename, mtime, r, status);
+    if (webInterp == NULL) {
+	if (admitted == ADMISSION_OK)
+	    admissionLeave(webInterpClass->admission);
+	return NULL;
+    }
+
     AP_LOG_DEBUG(r->server, "reserve WebInterp #%ld %ld/%ld of class %ld %s",
        webInterp->id,
        webInterp->numrequests, webInterp->interpClass->maxrequests,
@@ -330,8 +618,11 @@ WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
     );
 
     webInterp->req = r;
+    webInterp->admitted = (admitted == ADMISSION_OK);
     reserveWebInterp(webInterp);
 
+    webInterp->memoryMark = webInterpClass->maxmemory ? webHeapInUse() : -1;
+
     return webInterp;
 }
 
@@ -339,9 +630,198 @@ void poolReleaseThreadWebInterp(WebInterp * webInterp)
 {
     WebInterpClass *webInterpClass = webInterp->interpClass;
 
+    if (webInterp->admitted) {
+	webInterp->admitted = 0;
+	admissionLeave(webInterpClass->admission);
+    }
+
     releaseWebInterp(webInterp);
 
-    cleanupPool(webInterpClass->webshPool);
+    /* idle, ttl and other expired interps are destroyed by
+       poolReapThread after the request */
+}
+
+/* ----------------------------------------------------------------------------
+ * poolReapThread -- destroy expired interps of the current thread
+ *
+ * Called after the response has been sent. Sweeps at most every
+ * WebshReaperInterval seconds and stops destroying interps once
+ * WebshReaperMaxTime milliseconds are used up; the rest is left for the
+ * next tick.
+ * ------------------------------------------------------------------------- */
+void poolReapThread(websh_server_conf *conf)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    apr_time_t deadline = 0;
+    long t = (long) time(NULL);
+    int destroyed;
+
+    if (tsdPtr->conf == NULL || tsdPtr->webshPool == NULL) return;
+
+    if (conf->reaperInterval > 0 && (t - tsdPtr->lastReap) < conf->reaperInterval)
+	return;
+    tsdPtr->lastReap = t;
+
+    if (conf->reaperMaxTime > 0)
+	deadline = apr_time_now() + (apr_time_t) conf->reaperMaxTime * 1000;
+
+    destroyed = reapPool(tsdPtr->webshPool, deadline);
+
+#ifdef __GLIBC__
+    if (destroyed > 0 && conf->reaperTrim)
+	malloc_trim(0);
+#endif
+
+    AP_LOG_DEBUG(conf->server, "reaper destroyed %d interps", destroyed);
+}
+
+/* ----------------------------------------------------------------------------
+ * spare interps
+ *
+ * poolPrestartThread initializes the pool of the current thread and creates
+ * the interps of all classes listed by the WebshPrestart directive or
+ * configured with prestart/minspare, so that the first requests of this
+ * thread do not pay for the creation.
+ * There is no hook for the start of a worker thread and an interp cannot
+ * move to another thread, so this runs in the worker on the path of its
+ * first connection. warmClassSources reads the sources of these classes
+ * into the source cache at child init to take the file I/O off this path.
+ * poolRefillThreadWebInterp is called after a response has been sent and
+ * tops up the free interps of every class to its minspare value. The
+ * worker does this before it takes its next request.
+ * ------------------------------------------------------------------------- */
+
+static void poolSpawnWebInterp(WebInterpClass *webInterpClass, long numfree)
+{
+    WebInterp *webInterp;
+
+    while (webInterpClass->numfree < numfree) {
+	webInterp = poolCreateWebInterp(webInterpClass->conf, webInterpClass,
+					webInterpClass->filename,
+					webInterpClass->mtime, NULL);
+	if (webInterp == NULL) {
+	    /* error is logged already, don't retry now */
+	    break;
+	}
+	AP_LOG_DEBUG(webInterpClass->conf->server, "spawned WebInterp #%ld of class %s",
+		     webInterp->id, webInterpClass->filename);
+    }
+}
+
+static void warmClassSources(websh_server_conf *conf)
+{
+    Tcl_Interp *interp;
+    Tcl_Obj *objPtr;
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+    int i;
+
+    /* only for the error messages of the source cache */
+    interp = Tcl_CreateInterp();
+
+    if (conf->prestartClasses != NULL) {
+	for (i = 0; i < conf->prestartClasses->nelts; i++) {
+	    char *filename = ((char **) conf->prestartClasses->elts)[i];
+	    /* errors are logged when the thread creates the class */
+	    objPtr = sourceCacheGetObj(interp, filename, NULL);
+	    if (objPtr != NULL) {
+		Tcl_IncrRefCount(objPtr);
+		Tcl_DecrRefCount(objPtr);
+	    }
+	    Tcl_ResetResult(interp);
+	}
+    }
+
+    if (conf->classDefaults != NULL) {
+	entry = Tcl_FirstHashEntry(conf->classDefaults, &search);
+	while (entry != NULL) {
+	    WebInterpClassCfg *cfg = (WebInterpClassCfg *) Tcl_GetHashValue(entry);
+	    if (cfg->prestart > 0 || cfg->minspare > 0) {
+		char *filename = Tcl_GetHashKey(conf->classDefaults, entry);
+		objPtr = sourceCacheGetObj(interp, filename, NULL);
+		if (objPtr != NULL) {
+		    Tcl_IncrRefCount(objPtr);
+		    Tcl_DecrRefCount(objPtr);
+		}
+		Tcl_ResetResult(interp);
+	    }
+	    entry = Tcl_NextHashEntry(&search);
+	}
+    }
+
+    Tcl_DeleteInterp(interp);
+}
+
+int poolPrestartThread(websh_server_conf *conf, apr_thread_t *current_thread)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    WebInterpClass *webInterpClass;
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+    long numfree;
+    int i;
+
+    if (tsdPtr->conf != NULL) return TCL_OK;
+
+    initPoolThread(conf, current_thread);
+
+    if (tsdPtr->webshPool == NULL) return TCL_ERROR;
+
+    /* classes listed by WebshPrestart get at least one interp */
+    if (conf->prestartClasses != NULL) {
+	for (i = 0; i < conf->prestartClasses->nelts; i++) {
+	    char *filename = ((char **) conf->prestartClasses->elts)[i];
+	    webInterpClass = poolCreateWebInterpClass(conf, tsdPtr->webshPool, filename, 0);
+	    if (webInterpClass == NULL) {
+		AP_LOG_ERROR(conf->server, "cannot prestart webInterpClass '%s'", filename);
+		continue;
+	    }
+	    numfree = webInterpClass->prestart > webInterpClass->minspare ?
+		webInterpClass->prestart : webInterpClass->minspare;
+	    poolSpawnWebInterp(webInterpClass, numfree > 0 ? numfree : 1);
+	}
+    }
+
+    /* classes configured by web::interpclasscfg in the WebshConfig file */
+    if (conf->classDefaults == NULL) return TCL_OK;
+
+    entry = Tcl_FirstHashEntry(conf->classDefaults, &search);
+    while (entry != NULL) {
+	WebInterpClassCfg *cfg = (WebInterpClassCfg *) Tcl_GetHashValue(entry);
+	numfree = cfg->prestart > cfg->minspare ? cfg->prestart : cfg->minspare;
+	if (numfree > 0) {
+	    char *filename = Tcl_GetHashKey(conf->classDefaults, entry);
+	    webInterpClass = poolCreateWebInterpClass(conf, tsdPtr->webshPool, filename, 0);
+	    if (webInterpClass != NULL)
+		poolSpawnWebInterp(webInterpClass, numfree);
+	}
+	entry = Tcl_NextHashEntry(&search);
+    }
+
+    return TCL_OK;
+}
+
+void poolRefillThreadWebInterp(websh_server_conf *conf)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    WebInterpClass *webInterpClass;
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+
+    if (tsdPtr->conf == NULL || tsdPtr->webshPool == NULL) return;
+
+    entry = Tcl_FirstHashEntry(tsdPtr->webshPool, &search);
+    while (entry != NULL) {
+	webInterpClass = (WebInterpClass *) Tcl_GetHashValue(entry);
+	if (webInterpClass->reload && webInterpClass->trialInterp == NULL) {
+	    /* the response is out, prepare the new code for the next one */
+	    reloadWebInterpClass(conf, webInterpClass, NULL);
+	}
+	if (webInterpClass->numfree < webInterpClass->minspare) {
+	    poolSpawnWebInterp(webInterpClass, webInterpClass->minspare);
+	}
+	entry = Tcl_NextHashEntry(&search);
+    }
 }
 
 /* ----------------------------------------------------------------------------
@@ -361,6 +841,85 @@ static inline WebInterpClass *poolLookupWebInterpClass(Tcl_HashTable *webshPool,
     return webInterpClass;
 }
 
+/* ----------------------------------------------------------------------------
+ * saveClassDefaults -- keep the options the WebshConfig file gave the
+ * classes of the process pool, the pools of the threads start with them
+ * ------------------------------------------------------------------------- */
+static void saveClassDefaults(websh_server_conf *conf)
+{
+    WebInterpClass *webInterpClass;
+    WebInterpClassCfg *cfg;
+    Tcl_HashEntry *entry, *cfgEntry;
+    Tcl_HashSearch search;
+    int isnew = 0;
+
+    Tcl_MutexLock(&(conf->webshPoolLock));
+
+    HashUtlAllocInit(conf->classDefaults, TCL_STRING_KEYS);
+
+    entry = Tcl_FirstHashEntry(conf->webshPool, &search);
+    while (entry != NULL) {
+	webInterpClass = (WebInterpClass *) Tcl_GetHashValue(entry);
+
+	cfg = WebAllocInternalData(WebInterpClassCfg);
+	cfg->maxrequests = webInterpClass->maxrequests;
+	cfg->maxttl = webInterpClass->maxttl;
+	cfg->maxidletime = webInterpClass->maxidletime;
+	cfg->maxexectime = webInterpClass->maxexectime;
+	cfg->maxcommands = webInterpClass->maxcommands;
+	cfg->maxmemory = webInterpClass->maxmemory;
+	cfg->prestart = webInterpClass->prestart;
+	cfg->minspare = webInterpClass->minspare;
+
+	cfgEntry = Tcl_CreateHashEntry(conf->classDefaults,
+				       webInterpClass->filename, &isnew);
+	Tcl_SetHashValue(cfgEntry, (ClientData) cfg);
+
+	entry = Tcl_NextHashEntry(&search);
+    }
+
+    Tcl_MutexUnlock(&(conf->webshPoolLock));
+}
+
+static void applyClassDefaults(websh_server_conf *conf,
+			       WebInterpClass *webInterpClass)
+{
+    WebInterpClassCfg *cfg;
+    Tcl_HashEntry *entry;
+
+    /* read-only once the process is initialized, no lock needed */
+    if (conf->classDefaults == NULL)
+	return;
+    entry = Tcl_FindHashEntry(conf->classDefaults, webInterpClass->filename);
+    if (entry == NULL)
+	return;
+
+    cfg = (WebInterpClassCfg *) Tcl_GetHashValue(entry);
+    webInterpClass->maxrequests = cfg->maxrequests;
+    webInterpClass->maxttl = cfg->maxttl;
+    webInterpClass->maxidletime = cfg->maxidletime;
+    webInterpClass->maxexectime = cfg->maxexectime;
+    webInterpClass->maxcommands = cfg->maxcommands;
+    webInterpClass->maxmemory = cfg->maxmemory;
+    webInterpClass->prestart = cfg->prestart;
+    webInterpClass->minspare = cfg->minspare;
+}
+
+static void freeClassDefaults(websh_server_conf *conf)
+{
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+
+    if (conf->classDefaults == NULL)
+	return;
+    while ((entry = Tcl_FirstHashEntry(conf->classDefaults, &search)) != NULL) {
+	Tcl_Free((char *) Tcl_GetHashValue(entry));
+	Tcl_DeleteHashEntry(entry);
+    }
+    HashUtlDelFree(conf->classDefaults);
+    conf->classDefaults = NULL;
+}
+
 WebInterpClass *poolCreateWebInterpClass(
     websh_server_conf * conf,
     Tcl_HashTable *webshPool,
@@ -389,8 +948,7 @@ WebInterpClass *poolCreateWebInterpClass(
 
         if (mtime<=0) {
 	  struct stat statPtr;
-	  Tcl_Stat(filename, &statPtr);
-          mtime = statPtr.st_mtime;
+	  mtime = (Tcl_Stat(filename, &statPtr) == 0) ? statPtr.st_mtime : 0;
         }
 
 	webInterpClass->webshPool = webshPool;
@@ -401,14 +959,44 @@ WebInterpClass *poolCreateWebInterpClass(
 	webInterpClass->maxttl = 0L;
 	webInterpClass->maxidletime = 0L;
 
+	webInterpClass->maxexectime = 0L;
+	webInterpClass->maxcommands = 0L;
+	webInterpClass->maxmemory = 0L;
+	webInterpClass->budgetClass = budgetGetClass(filename);
+	webInterpClass->admission = admissionGetClass(filename);
+
+	webInterpClass->prestart = 0L;
+	webInterpClass->minspare = 0L;
+	webInterpClass->numfree = 0L;
+
+	if (webshPool != conf->webshPool)
+	    applyClassDefaults(conf, webInterpClass);
+
 	webInterpClass->mtime = mtime;
 
 	webInterpClass->nextid = 0;
 
+	webInterpClass->deps = NULL;
+	webInterpClass->numdeps = 0;
+	webInterpClass->maxdeps = 0;
+	/* read the epoch first, changes from now on must be seen */
+	webInterpClass->watchEpoch = fileWatchEpoch();
+	addWebInterpClassDep(webInterpClass, filename);
+
 	webInterpClass->first = NULL;
 	webInterpClass->last = NULL;
 
+	webInterpClass->freeFirst = NULL;
+	webInterpClass->freeLast = NULL;
+
 	webInterpClass->code = NULL;	/* will be loaded on demand by first interp */
+	webInterpClass->reload = 0;
+	webInterpClass->badMtime = 0;
+	webInterpClass->trialInterp = NULL;
+	webInterpClass->trialOldCode = NULL;
+	webInterpClass->trialOldMtime = 0;
+
+	memset(&(webInterpClass->stats), 0, sizeof(WebInterpClassStats));
 
 	int isnew = 0;
 	Tcl_HashEntry *entry;
@@ -441,6 +1029,10 @@ int poolDestroyWebInterpClass(WebInterpClass * webInterpClass)
     if (webInterpClass == NULL)
 	return TCL_ERROR;
 
+    /* no fall back, the class goes away */
+    webInterpClass->trialInterp = NULL;
+    WebDecrRefCountIfNotNullAndSetNull(webInterpClass->trialOldCode);
+
     while ((webInterpClass->first) != NULL) {
 	poolDestroyWebInterp(webInterpClass->first, WIP_FORCE_REMOVE);
     }
@@ -449,12 +1041,178 @@ int poolDestroyWebInterpClass(WebInterpClass * webInterpClass)
 	Tcl_DecrRefCount(webInterpClass->code);
     }
 
+    if (webInterpClass->deps != NULL) {
+	Tcl_Free((char *) webInterpClass->deps);
+    }
+
     Tcl_Free(webInterpClass->filename);
     Tcl_Free((char *) webInterpClass);
 
     return TCL_OK;
 }
 
+/* ----------------------------------------------------------------------------
+ * poolWebInterpClassStats -- counters of a class as key value list (a dict)
+ * ------------------------------------------------------------------------- */
+#define STATS_PUT(list, key, obj) \
+	Tcl_ListObjAppendElement(NULL, list, Tcl_NewStringObj(key, -1)); \
+	Tcl_ListObjAppendElement(NULL, list, obj);
+
+Tcl_Obj *poolWebInterpClassStats(WebInterpClass * webInterpClass, int withInterps)
+{
+    static const char *expiryNames[WIP_EXPIRY_NUM] = {
+	"requests", "ttl", "idle", "source", "retire", "limit", "memory",
+	"budget", "error"
+    };
+    static const char *stateNames[] = {
+	"inuse", "free", "expired", "expired_inuse"
+    };
+
+    WebInterpClassStats *stats = &(webInterpClass->stats);
+    Tcl_Obj *result = Tcl_NewObj();
+    Tcl_Obj *expired = Tcl_NewObj();
+    Tcl_Obj *interps = NULL;
+    WebInterp *webInterp;
+    long numfree = 0, numinuse = 0, numtotal = 0;
+    int i;
+
+    if (withInterps)
+	interps = Tcl_NewObj();
+
+    for (webInterp = webInterpClass->first; webInterp != NULL; webInterp = webInterp->next) {
+	numtotal++;
+	if (webInterp->state == WIP_FREE)
+	    numfree++;
+	else if (webInterp->state == WIP_INUSE || webInterp->state == WIP_EXPIRED_INUSE)
+	    numinuse++;
+
+	if (interps != NULL) {
+	    Tcl_Obj *info = Tcl_NewObj();
+	    STATS_PUT(info, "state", Tcl_NewStringObj(stateNames[webInterp->state], -1));
+	    STATS_PUT(info, "numrequests", Tcl_NewLongObj(webInterp->numrequests));
+	    STATS_PUT(info, "starttime", Tcl_NewLongObj(webInterp->starttime));
+	    STATS_PUT(info, "lastusedtime", Tcl_NewLongObj(webInterp->lastusedtime));
+	    STATS_PUT(info, "createtime", Tcl_NewLongObj(webInterp->createtime));
+	    STATS_PUT(info, "requesttime", Tcl_NewWideIntObj(webInterp->requesttime));
+	    STATS_PUT(info, "memory", Tcl_NewWideIntObj(webInterp->memory));
+	    /* key is the id of the interp */
+	    Tcl_ListObjAppendElement(NULL, interps, Tcl_NewLongObj(webInterp->id));
+	    Tcl_ListObjAppendElement(NULL, interps, info);
+	}
+    }
+
+    for (i = 0; i < WIP_EXPIRY_NUM; i++) {
+	STATS_PUT(expired, expiryNames[i], Tcl_NewLongObj(stats->expired[i]));
+    }
+
+    STATS_PUT(result, "acquired", Tcl_NewLongObj(stats->acquired));
+    STATS_PUT(result, "hits", Tcl_NewLongObj(stats->hits));
+    STATS_PUT(result, "misses", Tcl_NewLongObj(stats->acquired - stats->hits));
+    STATS_PUT(result, "created", Tcl_NewLongObj(stats->created));
+    STATS_PUT(result, "createtime", Tcl_NewWideIntObj(stats->createtime));
+    STATS_PUT(result, "expired", expired);
+    STATS_PUT(result, "reloads", Tcl_NewLongObj(stats->reloads));
+    STATS_PUT(result, "reloadfailures", Tcl_NewLongObj(stats->reloadfailures));
+    STATS_PUT(result, "requests", Tcl_NewLongObj(stats->requests));
+    STATS_PUT(result, "requesttime", Tcl_NewWideIntObj(stats->requesttime));
+    STATS_PUT(result, "readytime", Tcl_NewWideIntObj(stats->readytime));
+    STATS_PUT(result, "free", Tcl_NewLongObj(numfree));
+    STATS_PUT(result, "inuse", Tcl_NewLongObj(numinuse));
+    STATS_PUT(result, "total", Tcl_NewLongObj(numtotal));
+    STATS_PUT(result, "maxrequests", Tcl_NewLongObj(webInterpClass->maxrequests));
+    STATS_PUT(result, "maxttl", Tcl_NewLongObj(webInterpClass->maxttl));
+    STATS_PUT(result, "maxidletime", Tcl_NewLongObj(webInterpClass->maxidletime));
+    STATS_PUT(result, "maxexectime", Tcl_NewLongObj(webInterpClass->maxexectime));
+    STATS_PUT(result, "maxcommands", Tcl_NewLongObj(webInterpClass->maxcommands));
+    STATS_PUT(result, "maxmemory", Tcl_NewLongObj(webInterpClass->maxmemory));
+    STATS_PUT(result, "maxinterps", Tcl_NewLongObj(webInterpClass->budgetClass->max));
+    STATS_PUT(result, "budgetinterps", Tcl_NewLongObj(webInterpClass->budgetClass->count));
+    STATS_PUT(result, "admission", admissionStats(webInterpClass->admission));
+    if (interps != NULL) {
+	STATS_PUT(result, "interps", interps);
+    }
+
+    return result;
+}
+
+/* ----------------------------------------------------------------------------
+ * timing of a request -- durations between the timestamps of the phases.
+ * A phase that started but did not end yet lasts until now.
+ * firstbyte and total are counted from the start of the request.
+ * ------------------------------------------------------------------------- */
+static struct
+{
+    const char *name;
+    WebInterpPhase from;
+    WebInterpPhase to;
+    int open;			/* may end at now */
+}
+timingPhases[] = {
+    {"pre", WIP_PHASE_REQUEST, WIP_PHASE_HANDLER, 1},
+    {"acquire", WIP_PHASE_HANDLER, WIP_PHASE_ACQUIRED, 1},
+    {"init", WIP_PHASE_ACQUIRED, WIP_PHASE_INIT, 1},
+    {"script", WIP_PHASE_INIT, WIP_PHASE_SCRIPT, 1},
+    {"send", WIP_PHASE_SCRIPT, WIP_PHASE_SENT, 1},
+    {"cleanup", WIP_PHASE_SENT, WIP_PHASE_CLEANUP, 1},
+    {"release", WIP_PHASE_CLEANUP, WIP_PHASE_RELEASE, 1},
+    {"firstbyte", WIP_PHASE_REQUEST, WIP_PHASE_FIRSTBYTE, 0},
+    {"total", WIP_PHASE_REQUEST, WIP_PHASE_RELEASE, 0},
+    {NULL}
+};
+
+static long timingDuration(long *timing, int i, long now)
+{
+    long end = timing[timingPhases[i].to];
+
+    if (!timing[timingPhases[i].from])
+	return -1;
+    if (!end) {
+	if (!timingPhases[i].open)
+	    return -1;
+	end = now;
+    }
+    return (end > timing[timingPhases[i].from]) ? end - timing[timingPhases[i].from] : 0;
+}
+
+/* name duration pairs (usec) */
+Tcl_Obj *webInterpTimingObj(long *timing, long now)
+{
+    Tcl_Obj *result = Tcl_NewObj();
+    long duration;
+    int i;
+
+    for (i = 0; timingPhases[i].name != NULL; i++) {
+	if ((duration = timingDuration(timing, i, now)) < 0)
+	    continue;
+	STATS_PUT(result, timingPhases[i].name, Tcl_NewLongObj(duration));
+    }
+    return result;
+}
+
+/* Server-Timing header ("init;dur=0.125, ...") or note ("init=0.125 ...") in ms */
+char *webInterpTimingString(apr_pool_t *p, long *timing, long now, int header)
+{
+    Tcl_DString ds;
+    char buf[80];
+    char *result;
+    long duration;
+    int i;
+
+    Tcl_DStringInit(&ds);
+    for (i = 0; timingPhases[i].name != NULL; i++) {
+	if ((duration = timingDuration(timing, i, now)) < 0)
+	    continue;
+	sprintf(buf, header ? "%s%s;dur=%.3f" : "%s%s=%.3f",
+		Tcl_DStringLength(&ds) ? (header ? ", " : " ") : "",
+		timingPhases[i].name, duration / 1000.0);
+	Tcl_DStringAppend(&ds, buf, -1);
+    }
+    result = apr_pstrdup(p, Tcl_DStringValue(&ds));
+    Tcl_DStringFree(&ds);
+
+    return result;
+}
+
 
 static apr_status_t threadReleasePool(void *data)
 {
@@ -524,15 +1282,25 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
 	return NULL;
     }
 
+    apr_time_t createStart = apr_time_now();
+    Tcl_WideInt memoryStart = webInterpClass->maxmemory ? webHeapInUse() : -1;
     WebInterp *webInterp = (WebInterp *) Tcl_Alloc(sizeof(WebInterp));
 
+    /* only requests may evict other interps, spare ones are not created */
+    if (!budgetAdd(&(webInterp->budget), webInterpClass->budgetClass, r != NULL)) {
+	Tcl_Free((char *) webInterp);
+	AP_LOG_DEBUG(conf->server, "interp budget used up, no spare interp of class %s", filename);
+	return NULL;
+    }
+
     webInterp->interp = Tcl_CreateInterp();
 
     DEBUG_TRACE2(conf->server, "createWebInterp %p in thread %ld", webInterp->interp, Tcl_GetCurrentThread());
 
     if (webInterp->interp == NULL) {
+	budgetRemove(&(webInterp->budget));
 	Tcl_Free((char *) webInterp);
-	AP_LOG_RERROR(r, "createWebInterp: Could not create interpreter (id %ld, class %s)", webInterpClass->nextid, filename);
+	AP_LOG_POOL_ERROR(conf, r, "createWebInterp: Could not create interpreter (id %ld, class %s)", webInterpClass->nextid, filename);
 	return NULL;
     }
 
@@ -557,7 +1325,7 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
         **      And load code into webInterp->interpClass->code
         */
 	if (readWebInterpClassCode(webInterp, filename, mtime) != TCL_OK) {
-	    AP_LOG_RERROR(r, "Failed not read code from %s: %s", filename,
+	    AP_LOG_POOL_ERROR(conf, r, "Failed not read code from %s: %s", filename,
                 Tcl_GetStringResult(webInterp->interp));
 	}
     }
@@ -567,8 +1335,9 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
 	Tcl_IncrRefCount(webInterpClass->code);
     }
     if (webInterp->code == NULL){
-	AP_LOG_RERROR(r, "debug: mod_websh - WebInterp code is null, delete interp");
+	AP_LOG_POOL_ERROR(conf, r, "debug: mod_websh - WebInterp code is null, delete interp");
         Tcl_DeleteInterp(webInterp->interp);
+	budgetRemove(&(webInterp->budget));
 	Tcl_Free((char *) webInterp);
 	return NULL;
     }
@@ -585,8 +1354,9 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
      * --------------------------------------------------------------------- */
     logtoap = createLogPlugIn();
     if (logtoap == NULL){
-	AP_LOG_RERROR(r, "debug: mod_websh - createLogPlugIn fail");
+	AP_LOG_POOL_ERROR(conf, r, "debug: mod_websh - createLogPlugIn fail");
         Tcl_DeleteInterp(webInterp->interp);
+	budgetRemove(&(webInterp->budget));
 	Tcl_Free((char *) webInterp);
 	return NULL;
     }
@@ -617,6 +1387,17 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
     Tcl_CreateObjCommand(webInterp->interp, "web::interpclasscfg",
 			 Web_InterpClassCfg, (ClientData) webInterp, NULL);
 
+    Tcl_CreateObjCommand(webInterp->interp, "web::interpstats",
+			 Web_InterpStats, (ClientData) webInterp, NULL);
+
+    if (webInterpClass->numdeps > 0) {
+	/* watch every file the interp sources (e.g. web::include) */
+	Tcl_CreateObjCommand(webInterp->interp, "web::ap::depend",
+			     Web_ApDepend, (ClientData) webInterp, NULL);
+	Tcl_Eval(webInterp->interp, "trace add execution ::source enter ::web::ap::depend");
+	Tcl_ResetResult(webInterp->interp);
+    }
+
     /* ------------------------------------------------------------------------
      * rename exit !
      * --------------------------------------------------------------------- */
@@ -635,14 +1416,40 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
     webInterp->dtor = NULL;
     webInterp->state = WIP_FREE;
     webInterp->numrequests = 0;
+    webInterp->initFailed = 0;
     webInterp->starttime    = t;
     webInterp->lastusedtime = t;
     webInterp->id = webInterpClass->nextid++;
     webInterp->originThrdId = Tcl_GetCurrentThread();
+    webInterp->time_request = 0;
+    webInterp->time_ready = 0;
+
+    webInterp->requesttime = 0;
+    memset(webInterp->timing, 0, sizeof(webInterp->timing));
+    webInterp->memory = 0;
+    webInterp->memoryMark = -1;
+    webInterp->admitted = 0;
+    if (memoryStart >= 0) {
+	Tcl_WideInt inuse = webHeapInUse();
+	if (inuse > memoryStart)
+	    webInterp->memory = inuse - memoryStart;
+    }
+    webInterp->createtime = (long) (apr_time_now() - createStart);
+    webInterpClass->stats.created++;
+    webInterpClass->stats.createtime += webInterp->createtime;
 
     /* add to beginning of list of webInterpClass */
     DOUBLE_LIST_PREPEND(webInterp, webInterpClass->first, webInterpClass->last);
 
+    webInterp->nextFree = NULL;
+    webInterp->prevFree = NULL;
+    /* the interp of a request is reserved right away, it is never put
+       in the LRU list of the budget, where other threads could evict it */
+    if (r != NULL)
+	linkFreeWebInterp(webInterp);
+    else
+	pushFreeWebInterp(webInterp);
+
     return webInterp;
 }
 
@@ -652,6 +1459,9 @@ static WebInterp *poolCreateWebInterp(websh_server_conf * conf,
  * ------------------------------------------------------------------------- */
 static void removeWebInterp(WebInterp * webInterp)
 {
+    unlinkFreeWebInterp(webInterp);
+    budgetRemove(&(webInterp->budget));
+
     /* --------------------------------------------------------------------------
      * fixup list linkage
      * ----------------------------------------------------------------------- */
@@ -684,6 +1494,10 @@ static void poolDestroyWebInterp(WebInterp * webInterp, int flag)
 
     DEBUG_TRACE2(webInterp->interpClass->conf->server, "poolDestroyWebInterp %p", webInterp->interp);
 
+    /* gone before its first request: the new version is tried again */
+    if (webInterp->interpClass->trialInterp == webInterp)
+	endWebInterpClassTrial(webInterp->interpClass, -1);
+
     if (webInterp->dtor != NULL) {
 
 	int result;
@@ -758,6 +1572,243 @@ static Tcl_Obj *mapWebInterpClass(char *filename, Tcl_Interp *mainInterp){
 }
 
 
+/* ----------------------------------------------------------------------------
+ * addWebInterpClassDep -- watch filename for changes on behalf of the class
+ * ------------------------------------------------------------------------- */
+static void addWebInterpClassDep(WebInterpClass *webInterpClass, const char *filename)
+{
+    FileWatch *fileWatch;
+    int i;
+
+    fileWatch = fileWatchAdd(filename);
+    if (fileWatch == NULL)
+	return;
+
+    for (i = 0; i < webInterpClass->numdeps; i++) {
+	if (webInterpClass->deps[i].watch == fileWatch)
+	    return;
+    }
+
+    if (webInterpClass->numdeps == webInterpClass->maxdeps) {
+	webInterpClass->maxdeps = webInterpClass->maxdeps ? 2 * webInterpClass->maxdeps : 4;
+	webInterpClass->deps = (WebInterpClassDep *)
+	    Tcl_Realloc((char *) webInterpClass->deps,
+			webInterpClass->maxdeps * sizeof(WebInterpClassDep));
+    }
+    /* taken before the file is read, a change while reading is seen later */
+    webInterpClass->deps[webInterpClass->numdeps].watch = fileWatch;
+    webInterpClass->deps[webInterpClass->numdeps].generation = fileWatchGeneration(fileWatch);
+    webInterpClass->numdeps++;
+}
+
+/* ----------------------------------------------------------------------------
+ * isWebInterpClassStale -- true if a watched file of the class has changed
+ * ------------------------------------------------------------------------- */
+static int isWebInterpClassStale(WebInterpClass *webInterpClass)
+{
+    long epoch = fileWatchEpoch();
+    int i;
+
+    if (epoch == webInterpClass->watchEpoch)
+	return 0;
+    webInterpClass->watchEpoch = epoch;
+
+    for (i = 0; i < webInterpClass->numdeps; i++) {
+	if (fileWatchGeneration(webInterpClass->deps[i].watch)
+	    != webInterpClass->deps[i].generation)
+	    return 1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * web::ap::depend -- execution trace on source, records the sourced file
+ * as dependency of the class of the interp
+ * ------------------------------------------------------------------------- */
+static int Web_ApDepend(ClientData clientData, Tcl_Interp *interp,
+			int objc, Tcl_Obj *CONST objv[])
+{
+    WebInterp *webInterp = (WebInterp *) clientData;
+    Tcl_Obj **words = NULL;
+    Tcl_Obj *pathPtr;
+    int numwords = 0;
+
+    /* args: command-string enter */
+    if (objc < 2
+	|| Tcl_ListObjGetElements(NULL, objv[1], &numwords, &words) != TCL_OK
+	|| numwords < 2) {
+	return TCL_OK;
+    }
+
+    /* source ?-encoding name? fileName */
+    pathPtr = Tcl_FSGetNormalizedPath(NULL, words[numwords - 1]);
+    if (pathPtr != NULL)
+	addWebInterpClassDep(webInterp->interpClass, Tcl_GetString(pathPtr));
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * invalidateWebInterpClass -- source changed, drop interps and code
+ * ------------------------------------------------------------------------- */
+static void invalidateWebInterpClass(WebInterpClass *webInterpClass)
+{
+    WebInterp *webInterp;
+
+    /* invalidate all interpreters, code must be loaded from scratch */
+    for(webInterp = webInterpClass->first ; webInterp!= NULL ; webInterp = webInterp->next) {
+
+	logToAp(webInterp->interp, NULL,
+		"interpreter expired: source changed (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	expireWebInterpFor(webInterp, WIP_EXPIRY_SOURCE);
+    }
+    /* free code (will be loaded on demand) */
+    if (webInterpClass->code) {
+	Tcl_DecrRefCount(webInterpClass->code);
+	webInterpClass->code = NULL;
+    }
+
+    /* new interps record what they source again */
+    if (webInterpClass->numdeps > 0) {
+	webInterpClass->numdeps = 0;
+	webInterpClass->watchEpoch = fileWatchEpoch();
+	addWebInterpClassDep(webInterpClass, webInterpClass->filename);
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * markWebInterpClassStale -- source changed. The interps keep serving the
+ * old code until reloadWebInterpClass has the new one ready, unless the
+ * new version (mtime, 0: unknown) failed to load before.
+ * ------------------------------------------------------------------------- */
+static void markWebInterpClassStale(WebInterpClass *webInterpClass, long mtime)
+{
+    struct stat statPtr;
+
+    if (webInterpClass->code == NULL) {
+	/* nothing to keep, code is loaded on demand */
+	invalidateWebInterpClass(webInterpClass);
+	return;
+    }
+    if (webInterpClass->reload)
+	return;
+
+    if (webInterpClass->badMtime) {
+	if (mtime <= 0)
+	    mtime = (Tcl_Stat(webInterpClass->filename, &statPtr) == 0) ? statPtr.st_mtime : 0;
+	if (mtime == webInterpClass->badMtime)
+	    return;
+    }
+    webInterpClass->reload = 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * reloadWebInterpClass -- load the new code of a stale class and create an
+ * interp with it. The new version is on trial until that interp got
+ * through its first request (see endWebInterpClassTrial), the old interps
+ * keep their code until then. If the code cannot be loaded, it is kept and
+ * the error logged; the version is not tried again until the file changes.
+ * Returns the new interp (free), or NULL if there is none.
+ * ------------------------------------------------------------------------- */
+static WebInterp *reloadWebInterpClass(websh_server_conf * conf,
+				       WebInterpClass * webInterpClass,
+				       request_rec *r)
+{
+    Tcl_Obj *oldCode = webInterpClass->code;
+    long oldMtime = webInterpClass->mtime;
+    WebInterp *newInterp;
+    struct stat statPtr;
+
+    /* poolCreateWebInterp reads the file if the class has no code */
+    webInterpClass->code = NULL;
+    newInterp = poolCreateWebInterp(conf, webInterpClass,
+				    webInterpClass->filename, 0, r);
+    webInterpClass->reload = 0;
+
+    if (webInterpClass->code == NULL) {
+	webInterpClass->code = oldCode;
+	webInterpClass->mtime = oldMtime;
+	webInterpClass->badMtime =
+	    (Tcl_Stat(webInterpClass->filename, &statPtr) == 0) ? statPtr.st_mtime : 1;
+	webInterpClass->stats.reloadfailures++;
+	AP_LOG_POOL_ERROR(conf, r, "mod_websh - reload of %s failed, old version is kept",
+			  webInterpClass->filename);
+	return NULL;
+    }
+
+    webInterpClass->trialOldCode = oldCode;
+    webInterpClass->trialOldMtime = oldMtime;
+
+    if (newInterp == NULL) {
+	/* no interp to try it with: take the code as it is */
+	endWebInterpClassTrial(webInterpClass, 1);
+	return NULL;
+    }
+    webInterpClass->trialInterp = newInterp;
+
+    return newInterp;
+}
+
+/* ----------------------------------------------------------------------------
+ * endWebInterpClassTrial -- ok 1: the new version is taken, the interps
+ * with other code expire (the ones in use after their request). ok 0:
+ * web::initializer failed, the interps with the new code expire and the
+ * old code is taken again; the version is not tried again until the file
+ * changes. ok -1: the interp on trial is gone before its first request,
+ * the old code is taken again and the new version tried later.
+ * ------------------------------------------------------------------------- */
+static void endWebInterpClassTrial(WebInterpClass *webInterpClass, int ok)
+{
+    Tcl_Obj *newCode = webInterpClass->code;
+    WebInterp *webInterp;
+
+    webInterpClass->trialInterp = NULL;
+
+    if (ok <= 0) {
+	if (ok == 0) {
+	    webInterpClass->badMtime = webInterpClass->mtime;
+	    webInterpClass->stats.reloadfailures++;
+	    AP_LOG_ERROR(webInterpClass->conf->server,
+			 "mod_websh - web::initializer of the new version of %s failed, old version is kept",
+			 webInterpClass->filename);
+	} else {
+	    webInterpClass->reload = 1;
+	}
+	webInterpClass->code = webInterpClass->trialOldCode;
+	webInterpClass->mtime = webInterpClass->trialOldMtime;
+	webInterpClass->trialOldCode = NULL;
+
+	for (webInterp = webInterpClass->first; webInterp != NULL; webInterp = webInterp->next) {
+	    if (webInterp->code != newCode)
+		continue;
+	    logToAp(webInterp->interp, NULL,
+		    "interpreter expired: new version failed (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	    expireWebInterpFor(webInterp, WIP_EXPIRY_SOURCE);
+	}
+	Tcl_DecrRefCount(newCode);
+	return;
+    }
+
+    for (webInterp = webInterpClass->first; webInterp != NULL; webInterp = webInterp->next) {
+	if (webInterp->code == newCode)
+	    continue;
+	logToAp(webInterp->interp, NULL,
+		"interpreter expired: source changed (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+	expireWebInterpFor(webInterp, WIP_EXPIRY_SOURCE);
+    }
+    Tcl_DecrRefCount(webInterpClass->trialOldCode);
+    webInterpClass->trialOldCode = NULL;
+    webInterpClass->badMtime = 0;
+    webInterpClass->stats.reloads++;
+
+    /* the interps record what they source again */
+    if (webInterpClass->numdeps > 0) {
+	webInterpClass->numdeps = 0;
+	webInterpClass->watchEpoch = fileWatchEpoch();
+	addWebInterpClassDep(webInterpClass, webInterpClass->filename);
+    }
+}
+
 static WebInterpClass *updateWebInterpClass(
    WebInterpClass *webInterpClass,
    const char *newfile, long mtime
@@ -765,8 +1816,15 @@ static WebInterpClass *updateWebInterpClass(
 {
     const char *oldfile = webInterpClass->filename;
 
-    /* get last modified time for id */
-    if ( newfile!=oldfile && strcmp(newfile, oldfile) ) {
+    if (webInterpClass->numdeps > 0) {
+	/* the file watcher tells us about changes, no stat needed */
+	if (isWebInterpClassStale(webInterpClass))
+	    markWebInterpClassStale(webInterpClass, 0);
+	return webInterpClass;
+    }
+
+    /* get last modified time for id (mtime 0: not known by the caller) */
+    if ( mtime <= 0 || (newfile!=oldfile && strcmp(newfile, oldfile)) ) {
 	struct stat statPtr;
 	if (Tcl_Access(newfile, R_OK) != 0 ||
  	    Tcl_Stat(newfile, &statPtr) != TCL_OK)
@@ -777,23 +1835,7 @@ static WebInterpClass *updateWebInterpClass(
     }
 
     if (mtime > webInterpClass->mtime) {
-        /* invalidate all interpreters, code must be loaded from scratch */
-        WebInterp *webInterp;
-        for(webInterp = webInterpClass->first ; webInterp!= NULL ; webInterp = webInterp->next) {
-
-	    logToAp(webInterp->interp, NULL,
-		    "interpreter expired: source changed (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
-	    if (webInterp->state == WIP_INUSE){
-		webInterp->state = WIP_EXPIRED_INUSE;
-	    }else{
-		webInterp->state = WIP_EXPIRED;
-	    }
-        }
-        /* free code (will be loaded on demand) */
-        if (webInterpClass->code) {
-	    Tcl_DecrRefCount(webInterpClass->code);
-	    webInterpClass->code = NULL;
-        }
+        markWebInterpClassStale(webInterpClass, mtime);
     }
 
     return webInterpClass;
@@ -844,6 +1886,11 @@ WebInterp *poolGetWebInterp(websh_server_conf * conf, char *filename,
 
     DEBUG_TRACE(conf->server, "web::interpmap %s -> %s", filename, id);
 
+    if (strcmp(id, filename)) {
+	/* mtime of the request is not the one of the class script */
+	mtime = 0;
+    }
+
     Tcl_MutexUnlock(&(conf->mainInterpLock));
 
     Tcl_MutexLock(&(conf->webshPoolLock));
@@ -860,6 +1907,12 @@ WebInterp *poolGetWebInterp(websh_server_conf * conf, char *filename,
 	/* check if mtime is ok */
         webInterpClass = updateWebInterpClass(webInterpClass, id, mtime);
 
+	/* no refill phase in the shared pool, reload right away */
+	if (webInterpClass != NULL && webInterpClass->reload) {
+	    webInterpClass->reload = 0;
+	    invalidateWebInterpClass(webInterpClass);
+	}
+
         if( webInterpClass==NULL ){
 
             #ifndef APACHE2
@@ -876,6 +1929,8 @@ WebInterp *poolGetWebInterp(websh_server_conf * conf, char *filename,
 
         webInterp = poolGetFreeWebInterp(webInterpClass);
         found = webInterp;
+	if (found != NULL)
+	    webInterpClass->stats.hits++;
     } else {
 
 	/* no, we have to create this new interpreter class */
@@ -893,12 +1948,13 @@ WebInterp *poolGetWebInterp(websh_server_conf * conf, char *filename,
 	/* we have to create one */
 	found = poolCreateWebInterp(conf, webInterpClass, id, mtime, r);
     }
+    webInterpClass->stats.acquired++;
 
     DEBUG_TRACE2(conf->server, "poolGetWebInterp %p in thread %ld", found, Tcl_GetCurrentThread());
 
     if (found != NULL) {
 	/* mark the found one as INUSE */
-	found->state = WIP_INUSE;
+	reserveWebInterp(found);
     }
 
     Tcl_MutexUnlock(&(conf->webshPoolLock));
@@ -921,6 +1977,7 @@ void poolReleaseWebInterp(WebInterp * webInterp)
 	webInterp->lastusedtime = (long) time(NULL);
 
 	webInterp->numrequests++;
+	countWebInterpRequest(webInterp);
 
         DEBUG_TRACE(webInterpClass->conf->server, "numrequests = %d / %d , state = %d",
                 webInterp->numrequests, webInterpClass->maxrequests, webInterp->state);
@@ -937,7 +1994,10 @@ void poolReleaseWebInterp(WebInterp * webInterp)
 	    if (webInterpClass->maxrequests && (webInterp->numrequests >= webInterpClass->maxrequests)) {
 		logToAp(webInterp->interp, NULL,
 			"interpreter expired: request count reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+		webInterpClass->stats.expired[WIP_EXPIRY_REQUESTS]++;
 		webInterp->state = WIP_EXPIRED;
+	    } else {
+		pushFreeWebInterp(webInterp);
 	    }
 	}
 
@@ -970,8 +2030,26 @@ int initPool(websh_server_conf * conf)
 	return 0;
     }
 
-    /* create a single main interpreter */
-    conf->mainInterp = createMainInterp(conf);
+    /* watch script files instead of comparing their mtime */
+    if (conf->watchFiles && !fileWatchInit()) {
+#ifndef APACHE2
+	ap_log_printf(conf->server, "initPool: cannot watch files, checking mtime instead");
+#else /* APACHE2 */
+	ap_log_error(APLOG_MARK, APLOG_NOERRNO | APLOG_WARNING, 0, conf->server,
+		     "initPool: cannot watch files, checking mtime instead");
+#endif /* APACHE2 */
+    }
+
+    /* WebshMaxInterps, classes may add their own budget */
+    budgetSetMax(conf->maxInterps);
+
+    /* create our table of interp classes */
+    HashUtlAllocInit(conf->webshPool, TCL_STRING_KEYS);
+
+    /* create a single main interpreter, in a thread of its own
+       if possible (see mainthread.h) */
+    if (!mainThreadStart(conf))
+	conf->mainInterp = createMainInterp(conf, conf->webshPool);
 
     if (conf->mainInterp == NULL) {
 	errno = 0;
@@ -984,8 +2062,13 @@ int initPool(websh_server_conf * conf)
 	return 0;
     }
 
-    /* create our table of interp classes */
-    HashUtlAllocInit(conf->webshPool, TCL_STRING_KEYS);
+    /* the threads take the class options from here instead of
+       evaluating the WebshConfig file once more */
+    saveClassDefaults(conf);
+
+    /* the worker threads find the sources of their prestart classes
+       in the source cache */
+    warmClassSources(conf);
 
     /* if we're in threaded mode, spawn a watcher thread
        that runs a possibly defined code and does cleanup, something like:
@@ -1003,7 +2086,7 @@ int initPool(websh_server_conf * conf)
 /* ----------------------------------------------------------------------------
  * create main interpreter (including init stuff)
  * ------------------------------------------------------------------------- */
-Tcl_Interp *createMainInterp(websh_server_conf * conf)
+Tcl_Interp *createMainInterp(websh_server_conf * conf, WebshPool *webshPool)
 {
 
     LogPlugIn *logtoap = NULL;
@@ -1075,11 +2158,29 @@ Tcl_Interp *createMainInterp(websh_server_conf * conf)
 	return NULL;
     }
 
+    /* web::interpclasscfg in the main interp configures the classes
+       of the pool this main interp belongs to */
+    Tcl_SetAssocData(mainInterp, WEB_POOL_ASSOC_DATA, NULL, (ClientData) webshPool);
     Tcl_CreateObjCommand(mainInterp, "web::interpclasscfg",
 			 Web_InterpClassCfg, (ClientData) conf, NULL);
+    Tcl_CreateObjCommand(mainInterp, "web::interpstats",
+			 Web_InterpStats, (ClientData) conf, NULL);
+
+    /* only the main interp of the process publishes variables */
+    Tcl_CreateObjCommand(mainInterp, "web::mainpublish", Web_MainPublish,
+			 (webshPool == conf->webshPool) ? (ClientData) conf : NULL, NULL);
 
     initMainInterp(conf, mainInterp);
 
+    /* threads only need a main interp of their own for web::interpmap */
+    if (webshPool == conf->webshPool) {
+	conf->customInterpMap = 1;
+	if (Tcl_Eval(mainInterp, "info body web::interpmap") == TCL_OK)
+	    conf->customInterpMap =
+		strcmp(Tcl_GetStringResult(mainInterp), MAININTERP_MAPBODY) != 0;
+	Tcl_ResetResult(mainInterp);
+    }
+
     return mainInterp;
 }
 
@@ -1124,6 +2225,11 @@ void destroyPool(websh_server_conf * conf)
 	conf->webshPool = NULL;
     }
 
+    freeClassDefaults(conf);
+
+    /* deletes the main interp if it has a thread of its own */
+    mainThreadStop(conf);
+
     if (conf->mainInterp != NULL) {
 	/* now delete the interp */
         DEBUG_TRACE(conf->server, "Tcl_DeleteInterp mainInterp by thread %ld", Tcl_GetCurrentThread());
@@ -1132,22 +2238,30 @@ void destroyPool(websh_server_conf * conf)
 	conf->mainInterp = NULL;
     }
 
+    fileWatchFinalize();
+    sourceCacheFinalize();
+    mapCacheFlush();
+    budgetFinalize();
+    admissionFinalize();
 }
 
 
 /* -------------------------------------------------------------------------
- * cleanupPool NOTE: pool must be locked by caller
+ * reapPool -- expire idle and ttl interps and destroy all expired ones,
+ * stop destroying once deadline (0: none) has passed. Returns the number
+ * of destroyed interps.
  * ------------------------------------------------------------------------- */
-void cleanupPool(WebshPool *webshPool)
+static int reapPool(WebshPool *webshPool, apr_time_t deadline)
 {
 
-    if (webshPool == NULL) return;
+    if (webshPool == NULL) return 0;
 
     Tcl_HashEntry *entry;
     Tcl_HashSearch search;
     WebInterpClass *webInterpClass;
     WebInterp *webInterp, *expiredInterp;
     time_t t;
+    int destroyed = 0;
 
     time(&t);
 
@@ -1162,28 +2276,38 @@ void cleanupPool(WebshPool *webshPool)
 	    if ((webInterp->state) == WIP_FREE) {
 
 		/* check for expiry */
-		if (webInterpClass->maxidletime
+		if (budgetEvicted(&(webInterp->budget))) {
+		    logToAp(webInterp->interp, NULL,
+			    "interpreter expired: evicted by interp budget (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
+		    expireWebInterpFor(webInterp, WIP_EXPIRY_BUDGET);
+		} else if (webInterpClass->maxidletime
 		    && (t - webInterp->lastusedtime) >
 		    webInterpClass->maxidletime) {
 		    logToAp(webInterp->interp, NULL,
 			    "interpreter expired: idle time reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
-		    webInterp->state = WIP_EXPIRED;
+		    expireWebInterpFor(webInterp, WIP_EXPIRY_IDLE);
 		} else {
 		    if (webInterpClass->maxttl
 			&& (t - webInterp->starttime) >
 			webInterpClass->maxttl) {
 			logToAp(webInterp->interp, NULL,
 				"interpreter expired: time to live reached (id %ld, class %s)", webInterp->id, webInterp->interpClass->filename);
-			webInterp->state = WIP_EXPIRED;
+			expireWebInterpFor(webInterp, WIP_EXPIRY_TTL);
 		    }
 		}
 	    }
 	    expiredInterp = webInterp;
 	    webInterp = webInterp->next;
 
-	    if (expiredInterp->state == WIP_EXPIRED){
+	    if (expiredInterp->state == WIP_EXPIRED
+		&& expiredInterp->originThrdId == Tcl_GetCurrentThread()) {
+		if (deadline && apr_time_now() > deadline) {
+		    /* out of time, keep it for the next tick */
+		    continue;
+		}
 		poolDestroyWebInterp(expiredInterp, WIP_CHECK_THREAD);
-            }
+		destroyed++;
+	    }
 	}
 
         // TODO: Need destroy unused WebInterpClass to release resource.
@@ -1200,7 +2324,15 @@ void cleanupPool(WebshPool *webshPool)
 	entry = Tcl_NextHashEntry(&search);
     }
 
-    return;
+    return destroyed;
+}
+
+/* -------------------------------------------------------------------------
+ * cleanupPool NOTE: pool must be locked by caller
+ * ------------------------------------------------------------------------- */
+void cleanupPool(WebshPool *webshPool)
+{
+    reapPool(webshPool, 0);
 }
 
 
@@ -1212,31 +2344,28 @@ static int readWebInterpClassCode(WebInterp *webInterp, char *filename, long mti
 
     WebInterpClass *webInterpClass =  webInterp->interpClass;
     Tcl_Interp *interp = webInterp->interp;
-    Tcl_Channel chan;
+    Tcl_Obj *objPtr;
+    long cachedMtime = 0;
 
-    chan = Tcl_OpenFileChannel(interp, filename, "r", 0644);
-    if (chan == (Tcl_Channel) NULL) {
-	Tcl_ResetResult(interp);
-	Tcl_AppendResult(interp, "couldn't read file \"", filename,
-			 "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()), (char *) NULL);
-    } else {
-        Tcl_Obj *objPtr = Tcl_NewObj();
-	if (Tcl_ReadChars(chan, objPtr, -1, 0) < 0) {
-	    Tcl_Close(interp, chan);
-	    Tcl_AppendResult(interp, "couldn't read file \"", filename,
-			     "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()), (char *) NULL);
-	} else {
-	    if (Tcl_Close(interp, chan) == TCL_OK) {
-		/* finally success ... */
-		webInterpClass->code = objPtr;
-	        webInterpClass->mtime = mtime;
-                Tcl_IncrRefCount(objPtr);
-		return TCL_OK;
-	    }
-	}
-        Tcl_DecrRefCount(objPtr);
+    /* the file is read once per process, not once per thread */
+    objPtr = sourceCacheGetObj(interp, filename, &cachedMtime);
+    if (objPtr == NULL) {
+	return TCL_ERROR;
     }
-    return TCL_ERROR;
+
+    Tcl_IncrRefCount(objPtr);
+
+    /* a new version must not replace working code with a broken one */
+    if (webInterpClass->reload && !Tcl_CommandComplete(Tcl_GetString(objPtr))) {
+	Tcl_DecrRefCount(objPtr);
+	Tcl_SetResult(interp, "script is incomplete (missing close-brace or quote?)",
+		      TCL_STATIC);
+	return TCL_ERROR;
+    }
+
+    webInterpClass->code = objPtr;
+    webInterpClass->mtime = (mtime > 0) ? mtime : cachedMtime;
+    return TCL_OK;
 }
 
 ApFuncs *createApFuncs() {
@@ -1256,6 +2385,8 @@ ApFuncs *createApFuncs() {
   apFuncs->Web_MainEval = Web_MainEval_AP;
   apFuncs->Web_ConfigPath = Web_ConfigPath_AP;
   apFuncs->ModWebsh_Init = ModWebsh_Init_AP;
+  apFuncs->Web_InterpStats = Web_InterpStats_AP;
+  apFuncs->requestGetTiming = requestGetTiming_AP;
   return apFuncs;
 }
 
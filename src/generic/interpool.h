@@ -16,6 +16,8 @@
 #ifndef WEBSHPOOL_H
 #define WEBSHPOOL_H
 
+#define WEB_POOL_ASSOC_DATA "web::pool"
+
 #include "tcl.h"		/* tcl is not necesseraly a system-wide include */
 #include "macros.h"		/* for WebAssert and friends. can also reside in .c */
 #include "hashutl.h"		/* hash table utitilies */
@@ -24,6 +26,9 @@
 #include "modwebsh.h"
 #include "mod_websh.h"
 #include "modwebsh_cgi.h"
+#include "filewatch.h"
+#include "budget.h"
+#include "admission.h"
 
 /* ----------------------------------------------------------------------------
  * the interp-pool is kept in a hash table where
@@ -38,6 +43,32 @@ typedef enum WebInterpState
 }
 WebInterpState;
 
+/* why an interp expired, see WebInterpClassStats */
+typedef enum WebInterpExpiry
+{
+    WIP_EXPIRY_REQUESTS, WIP_EXPIRY_TTL, WIP_EXPIRY_IDLE,
+    WIP_EXPIRY_SOURCE, WIP_EXPIRY_RETIRE, WIP_EXPIRY_LIMIT, WIP_EXPIRY_MEMORY,
+    WIP_EXPIRY_BUDGET, WIP_EXPIRY_ERROR,
+    WIP_EXPIRY_NUM
+}
+WebInterpExpiry;
+
+/* timestamps taken while a request is handled, see web::request -timing */
+typedef enum WebInterpPhase
+{
+    WIP_PHASE_REQUEST,		/* request received by the server */
+    WIP_PHASE_HANDLER,		/* handler of mod_websh called */
+    WIP_PHASE_ACQUIRED,		/* interp taken from the pool */
+    WIP_PHASE_INIT,		/* per-request reset done */
+    WIP_PHASE_SCRIPT,		/* script done */
+    WIP_PHASE_FIRSTBYTE,	/* response headers sent */
+    WIP_PHASE_SENT,		/* response complete and flushed */
+    WIP_PHASE_CLEANUP,		/* onexit, web::defer and per-request reset done */
+    WIP_PHASE_RELEASE,		/* interp back in the pool */
+    WIP_PHASE_NUM
+}
+WebInterpPhase;
+
 struct WebInterpClass;
 
 
@@ -64,10 +95,24 @@ typedef struct WebInterp
     long time_ready;		/* time when interp is ready */
     long id;                    /* id of the interpreter */
 
+    /* statistics */
+    long createtime;		/* time it took to create the interp (usec) */
+    Tcl_WideInt requesttime;	/* wall time of all its requests (usec) */
+    long timing[WIP_PHASE_NUM];	/* phases of the current request (usec) */
+    Tcl_WideInt memory;		/* bytes allocated by the interp (estimate) */
+    Tcl_WideInt memoryMark;	/* memory of the thread at request start */
+    BudgetLink budget;		/* process-wide interp budget */
+    int admitted;		/* request counts for maxconcurrent */
+    int initFailed;		/* web::initializer failed */
+
     /* we double-link this list so it's easier to remove elements */
     struct WebInterp *next;
     struct WebInterp *prev;
 
+    /* free list of the class (only linked while state is WIP_FREE) */
+    struct WebInterp *nextFree;
+    struct WebInterp *prevFree;
+
     Tcl_ThreadId originThrdId;	/* Origin thread where this token was created */
 }
 WebInterp;
@@ -75,6 +120,45 @@ WebInterp;
 
 typedef Tcl_HashTable WebshPool;
 
+/* counters of a class, see web::interpstats */
+typedef struct WebInterpClassStats
+{
+    long acquired;		/* interps handed out to requests */
+    long hits;			/* ... of them taken from the free list */
+    long created;		/* interps created */
+    Tcl_WideInt createtime;	/* time spent creating interps (usec) */
+    long expired[WIP_EXPIRY_NUM];	/* expired interps by reason */
+    long reloads;		/* new versions of the code taken */
+    long reloadfailures;	/* ... and ones that failed to load */
+    long requests;		/* requests finished */
+    Tcl_WideInt requesttime;	/* wall time of the requests (usec) */
+    Tcl_WideInt readytime;	/* time until the interp was ready (usec) */
+}
+WebInterpClassStats;
+
+/* a file the code of a class depends on (with a file watcher only) */
+typedef struct WebInterpClassDep
+{
+    FileWatch *watch;
+    long generation;		/* generation of the file when it was read */
+}
+WebInterpClassDep;
+
+/* options of a class set by web::interpclasscfg in the WebshConfig file,
+   read once from the main interp and shared by the classes of all threads */
+typedef struct WebInterpClassCfg
+{
+    long maxrequests;
+    long maxttl;
+    long maxidletime;
+    long maxexectime;
+    long maxcommands;
+    long maxmemory;
+    long prestart;
+    long minspare;
+}
+WebInterpClassCfg;
+
 typedef struct WebInterpClass
 {
 
@@ -87,13 +171,50 @@ typedef struct WebInterpClass
     long maxttl;
     long maxidletime;
     long mtime;
+
+    /* resource limits of a request */
+    long maxexectime;           /* milliseconds the script may run */
+    long maxcommands;           /* commands the script may execute */
+    long maxmemory;             /* kilobytes an interp may grow to */
+    BudgetClass *budgetClass;   /* maxinterps, shared by all threads */
+    AdmissionClass *admission;  /* maxconcurrent etc., shared by all threads */
+
+    /* spare interps */
+    long prestart;              /* interps to create when a thread starts */
+    long minspare;              /* free interps to keep after requests */
+    long numfree;               /* length of the free list */
+
     long nextid;                /* counter for ids of interpreters */
 
+    /* files watched for changes: the class file and every file sourced
+       by its interps. numdeps is 0 if the mtime has to be polled */
+    WebInterpClassDep *deps;
+    int numdeps;
+    int maxdeps;
+    long watchEpoch;            /* epoch of the watcher when last checked */
+
+    WebInterpClassStats stats;
+
     Tcl_Obj *code;		/* per-request code (=file content) */
 
+    /* the source changed: the interps serve the old code until an interp
+       with the new one is ready (after a response or on a pool miss) */
+    int reload;
+    long badMtime;		/* mtime of a version that failed to load */
+
+    /* a new version is on trial: the old interps expire once its first
+       interp got through its first request (web::initializer) */
+    WebInterp *trialInterp;
+    Tcl_Obj *trialOldCode;	/* the code to fall back to */
+    long trialOldMtime;
+
     WebInterp *first;
     WebInterp *last;
 
+    /* free interps, most recently released first (LIFO) */
+    WebInterp *freeFirst;
+    WebInterp *freeLast;
+
     /* configuration of our main Interpreter */
     websh_server_conf *conf;
 
@@ -133,6 +254,7 @@ WebInterpClass;
  */
 
 int initPool(websh_server_conf * conf);
+Tcl_Interp *createMainInterp(websh_server_conf * conf, WebshPool *webshPool);
 
 WebInterpClass *poolCreateWebInterpClass(websh_server_conf * conf, Tcl_HashTable *webshPool, char *filename, long mtime);
 
@@ -147,18 +269,84 @@ void cleanupPool(WebshPool *webshPool);
 ApFuncs* createApFuncs();
 void destroyApFuncs(ClientData apFuncs, Tcl_Interp *interp);
 
+Tcl_Obj *poolWebInterpClassStats(WebInterpClass *webInterpClass, int withInterps);
+
+#define WEB_TIMING_NOTE "websh-timing"
+Tcl_Obj *webInterpTimingObj(long *timing, long now);
+char *webInterpTimingString(apr_pool_t *p, long *timing, long now, int header);
+
 /* ----------------------------------------------------------------------------
  * Thread specific inter pool
 WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
-			    long mtime, request_rec * r)
+			    long mtime, request_rec * r, int *status)
  * ------------------------------------------------------------------------- */
 
 WebInterp *poolGetThreadWebInterp(websh_server_conf *conf, char *filename,
-			    long mtime, request_rec * r);
+			    long mtime, request_rec * r, int *status);
 void poolReleaseThreadWebInterp(WebInterp * webInterp);
+int poolPrestartThread(websh_server_conf *conf, apr_thread_t *current_thread);
+void poolRefillThreadWebInterp(websh_server_conf *conf);
+void poolReapThread(websh_server_conf *conf);
 static apr_status_t destroyPoolThread(void *data);
 
-static inline void expireWebInterp(WebInterp * webInterp){
+/* ----------------------------------------------------------------------------
+ * free list of a WebInterpClass
+ *
+ * Every WebInterp in state WIP_FREE is also linked into the free list of its
+ * class. New and released interps are pushed to the front, so the most
+ * recently used (hottest) interp is handed out first and the idle ones
+ * accumulate at the end of the list.
+ * ------------------------------------------------------------------------- */
+
+static inline int isFreeWebInterp(WebInterp * webInterp){
+  return (webInterp->prevFree != NULL
+	  || webInterp->interpClass->freeFirst == webInterp);
+}
+
+/* free list of the class only, not the LRU list of the budget */
+static inline void linkFreeWebInterp(WebInterp * webInterp){
+  WebInterpClass *webInterpClass = webInterp->interpClass;
+
+  webInterp->prevFree = NULL;
+  webInterp->nextFree = webInterpClass->freeFirst;
+  if (webInterpClass->freeFirst != NULL)
+    webInterpClass->freeFirst->prevFree = webInterp;
+  else
+    webInterpClass->freeLast = webInterp;
+  webInterpClass->freeFirst = webInterp;
+  webInterpClass->numfree++;
+}
+
+static inline void pushFreeWebInterp(WebInterp * webInterp){
+  linkFreeWebInterp(webInterp);
+  budgetPushFree(&(webInterp->budget));
+}
+
+static inline void unlinkFreeWebInterp(WebInterp * webInterp){
+  WebInterpClass *webInterpClass = webInterp->interpClass;
+
+  if (!isFreeWebInterp(webInterp)) return;
+
+  if (webInterp->prevFree != NULL)
+    webInterp->prevFree->nextFree = webInterp->nextFree;
+  else
+    webInterpClass->freeFirst = webInterp->nextFree;
+
+  if (webInterp->nextFree != NULL)
+    webInterp->nextFree->prevFree = webInterp->prevFree;
+  else
+    webInterpClass->freeLast = webInterp->prevFree;
+
+  webInterp->nextFree = NULL;
+  webInterp->prevFree = NULL;
+  webInterpClass->numfree--;
+}
+
+static inline void expireWebInterpFor(WebInterp * webInterp,
+				      WebInterpExpiry reason){
+  unlinkFreeWebInterp(webInterp);
+  if (webInterp->state == WIP_INUSE || webInterp->state == WIP_FREE)
+    webInterp->interpClass->stats.expired[reason]++;
   if (webInterp->state == WIP_INUSE) {
     webInterp->state = WIP_EXPIRED_INUSE;
   } else if (webInterp->state == WIP_EXPIRED_INUSE) {
@@ -168,4 +356,9 @@ static inline void expireWebInterp(WebInterp * webInterp){
   }
 }
 
+/* expired because something went wrong */
+static inline void expireWebInterp(WebInterp * webInterp){
+  expireWebInterpFor(webInterp, WIP_EXPIRY_ERROR);
+}
+
 #endif
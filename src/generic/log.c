@@ -18,10 +18,71 @@
 #include "logtocmd.h"
 #include "logtofile.h"
 #include "logtosyslog.h"
+#include "reset.h"
 #include "tcl.h"
 #include <stdio.h>
 
 
+/* ----------------------------------------------------------------------------
+ * resetLogHook -- per-request reset hook, see reset.h
+ * ------------------------------------------------------------------------- */
+static int resetLogHook(Tcl_Interp * interp, ClientData clientData)
+{
+    return resetLogData(interp, (LogData *) clientData);
+}
+
+/* ----------------------------------------------------------------------------
+ * built-in log handlers, shared by all interps. Handlers registered with
+ * registerLogPlugIn (e.g. apachelog) are kept per interp.
+ * ------------------------------------------------------------------------- */
+static const LogPlugIn logToChannelPlugIn =
+    { createLogToChannel, destroyLogToChannel, logToChannel };
+static const LogPlugIn logToFilePlugIn =
+    { createLogToFile, destroyLogToFile, logToFile };
+static const LogPlugIn logToCmdPlugIn =
+    { createLogToCmd, destroyLogToCmd, logToCmd };
+#ifndef WIN32
+static const LogPlugIn logToSyslogPlugIn =
+    { createLogToSyslog, destroyLogToSyslog, logToSyslog };
+#endif
+
+static const struct
+{
+    const char *type;
+    const LogPlugIn *plugIn;
+}
+logBuiltinPlugIns[] = {
+    {"channel", &logToChannelPlugIn},
+    {"file", &logToFilePlugIn},
+    {"command", &logToCmdPlugIn},
+#ifndef WIN32
+    {"syslog", &logToSyslogPlugIn},
+#endif
+    {NULL, NULL}
+};
+
+/* ----------------------------------------------------------------------------
+ * getLogPlugIn -- handler for type, NULL if there is none
+ * ------------------------------------------------------------------------- */
+static LogPlugIn *getLogPlugIn(LogData * logData, const char *type)
+{
+
+    LogPlugIn *logPlugIn = NULL;
+    int i;
+
+    if (logData->listOfPlugIns != NULL) {
+	logPlugIn = (LogPlugIn *) getFromHashTable(logData->listOfPlugIns,
+						   (char *) type);
+	if (logPlugIn != NULL)
+	    return logPlugIn;
+    }
+    for (i = 0; logBuiltinPlugIns[i].type != NULL; i++) {
+	if (!strcmp(logBuiltinPlugIns[i].type, type))
+	    return (LogPlugIn *) logBuiltinPlugIns[i].plugIn;
+    }
+    return NULL;
+}
+
 /* ----------------------------------------------------------------------------
  * Init --
  *   entry point for module weblog of websh3
@@ -30,11 +91,6 @@ int __declspec(dllexport) log_Init(Tcl_Interp * interp)
 {
 
     LogData *logData = NULL;
-    LogPlugIn *logtofile = NULL;
-    LogPlugIn *logtochannel = NULL;
-    LogPlugIn *logtocmd = NULL;
-    LogPlugIn *logtosyslog = NULL;
-    int ires = 0;
 
     /* --------------------------------------------------------------------------
      * interpreter running ?
@@ -54,6 +110,9 @@ int __declspec(dllexport) log_Init(Tcl_Interp * interp)
     Tcl_SetAssocData(interp, WEB_LOG_ASSOC_DATA,
 		     destroyLogData, (ClientData) logData);
 
+    webRegisterReset(interp, WEB_RESET_CLEANUP,
+		     resetLogHook, (ClientData) logData);
+
     /* --------------------------------------------------------------------------
      * register commands
      * ----------------------------------------------------------------------- */
@@ -75,55 +134,10 @@ int __declspec(dllexport) log_Init(Tcl_Interp * interp)
 			 (ClientData) logData, (Tcl_CmdDeleteProc *) NULL);
 
     /* --------------------------------------------------------------------------
-     * register log handler "channel"
+     * the log handlers channel, file, command and syslog are built in,
+     * see logBuiltinPlugIns
      * ----------------------------------------------------------------------- */
-    logtochannel = createLogPlugIn();
-    WebAssertData(interp, logtochannel, "log_Init/logtochannel plugin",
-		  TCL_ERROR)
-
-    logtochannel->constructor = createLogToChannel;
-    logtochannel->destructor = destroyLogToChannel;
-    logtochannel->handler = logToChannel;
-
-    ires = registerLogPlugIn(interp, "channel", logtochannel);
-
-    /* --------------------------------------------------------------------------
-     * register log handler "file"
-     * ----------------------------------------------------------------------- */
-    logtofile = createLogPlugIn();
-    WebAssertData(interp, logtofile, "log_Init/logtofile plugin", TCL_ERROR)
-
-    logtofile->constructor = createLogToFile;
-    logtofile->destructor = destroyLogToFile;
-    logtofile->handler = logToFile;
-
-    ires = registerLogPlugIn(interp, "file", logtofile);
-
-    /* --------------------------------------------------------------------------
-     * register log handler "command"
-     * ----------------------------------------------------------------------- */
-    logtocmd = createLogPlugIn();
-    WebAssertData(interp, logtocmd, "log_Init/logtocmd plugin", TCL_ERROR)
-
-	logtocmd->constructor = createLogToCmd;
-    logtocmd->destructor = destroyLogToCmd;
-    logtocmd->handler = logToCmd;
-
-    ires = registerLogPlugIn(interp, "command", logtocmd);
 
-    /* --------------------------------------------------------------------------
-     * register log handler "syslog"
-     * ----------------------------------------------------------------------- */
-#ifndef WIN32
-    logtosyslog = createLogPlugIn();
-    WebAssertData(interp, logtocmd, "log_Init/logtosyslog plugin", TCL_ERROR)
-
-    logtosyslog->constructor = createLogToSyslog;
-    logtosyslog->destructor = destroyLogToSyslog;
-    logtosyslog->handler = logToSyslog;
-
-    ires = registerLogPlugIn(interp, "syslog", logtosyslog);
-#endif
     /* --------------------------------------------------------------------------
      * done
      * ----------------------------------------------------------------------- */
@@ -151,7 +165,8 @@ LogData *createLogData()
 	insertIntoFilterList(logData, (LogLevel *) NULL);
 	insertIntoDestList(logData, (LogDest *) NULL);
 
-	HashUtlAllocInit(logData->listOfPlugIns, TCL_STRING_KEYS);
+	/* created by registerLogPlugIn */
+	logData->listOfPlugIns = NULL;
 	logData->logSubst = LOG_SUBSTDEFAULT;
 	logData->safeLog = LOG_SAFEDEFAULT;
 	logData->keep = 0;
@@ -215,6 +230,52 @@ void destroyLogData(ClientData clientData, Tcl_Interp * interp)
     }
 }
 
+/* ----------------------------------------------------------------------------
+ * deleteRequestLogDests, deleteRequestLogFilters -- delete all
+ *   destinations/filters NOT created during web::initializer
+ * ------------------------------------------------------------------------- */
+static void deleteRequestLogDests(Tcl_Interp * interp, LogData * logData)
+{
+    int i;
+    LogDest ** logDests = logData->listOfDests;
+
+    for (i = 0; i < logData->destSize; i++) {
+	if (logDests[i] != NULL && !logDests[i]->keep) {
+	    destroyLogDest(logDests[i], interp);
+	    logDests[i] = NULL;
+	}
+    }
+}
+
+static void deleteRequestLogFilters(Tcl_Interp * interp, LogData * logData)
+{
+    int i;
+    LogLevel ** logLevels = logData->listOfFilters;
+
+    for (i = 0; i < logData->filterSize; i++) {
+	if (logLevels[i] != NULL && !logLevels[i]->keep) {
+	    destroyLogLevel(logLevels[i], interp);
+	    logLevels[i] = NULL;
+	}
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * resetLogData -- reset logging after a request (except stuff from
+ *   web::initializer)
+ * ------------------------------------------------------------------------- */
+int resetLogData(Tcl_Interp * interp, LogData * logData)
+{
+
+    if ((interp == NULL) || (logData == NULL))
+	return TCL_ERROR;
+
+    deleteRequestLogFilters(interp, logData);
+    deleteRequestLogDests(interp, logData);
+
+    return TCL_OK;
+}
+
 
 /* ----------------------------------------------------------------------------
  * createLogLevel -- allocate memory for a new LogLevel, and set content
@@ -582,10 +643,7 @@ int Web_LogDest(ClientData clientData,
 	    /* ------------------------------------------------------------------------
 	     * get handler for type
 	     * --------------------------------------------------------------------- */
-	    logPlugIn = (LogPlugIn *) getFromHashTable(logData->listOfPlugIns,
-						       Tcl_GetString(objv
-								     [iCurArg
-								      + 1]));
+	    logPlugIn = getLogPlugIn(logData, Tcl_GetString(objv[iCurArg + 1]));
 	    if (logPlugIn == NULL) {
 		Tcl_SetResult(interp, "no log handler of type \"", NULL);
 		Tcl_AppendResult(interp, Tcl_GetString(objv[iCurArg + 1]),
@@ -712,13 +770,7 @@ int Web_LogDest(ClientData clientData,
 	      LogDest ** logDests = logData->listOfDests;
 	      if (!strcmp("-requests", Tcl_GetString(objv[2]))) {
 		/* special case: delete all destinations NOT created during web::initializer */
-		int i;
-		for (i = 0; i < logData->destSize; i++) {
-		  if (logDests[i] != NULL && !logDests[i]->keep) {
-		    destroyLogDest(logDests[i], interp);
-		    logDests[i] = NULL;
-		  }
-		}
+		deleteRequestLogDests(interp, logData);
 		return TCL_OK;
 	      } else {
 		int inx = getIndexFromLogName(LOG_DEST_PREFIX"%d", Tcl_GetString(objv[2]));
@@ -912,13 +964,7 @@ int Web_LogFilter(ClientData clientData,
 	      LogLevel ** logLevels = logData->listOfFilters;
 	      if (!strcmp("-requests", Tcl_GetString(objv[2]))) {
 		/* special case: delete all levels NOT created during web::initializer */
-		int i;
-		for (i = 0; i < logData->filterSize; i++) {
-		  if (logLevels[i] != NULL && !logLevels[i]->keep) {
-		    destroyLogLevel(logLevels[i], interp);
-		    logLevels[i] = NULL;
-		  }
-		}
+		deleteRequestLogFilters(interp, logData);
 		return TCL_OK;
 	      } else {
 		int inx = getIndexFromLogName(LOG_FILTER_PREFIX"%d", Tcl_GetString(objv[2]));
@@ -1017,7 +1063,10 @@ int __declspec(dllexport) registerLogPlugIn(Tcl_Interp * interp, char *type, Log
 	/* --------------------------------------------------------------------------
 	 * append
 	 * ----------------------------------------------------------------------- */
-	if (logData->listOfPlugIns == NULL)
+	if (logData->listOfPlugIns == NULL) {
+	HashUtlAllocInit(logData->listOfPlugIns, TCL_STRING_KEYS);
+    }
+    if (logData->listOfPlugIns == NULL)
 	return TCL_ERROR;
     return appendToHashTable(logData->listOfPlugIns, type,
 			     (ClientData) logPlugIn);
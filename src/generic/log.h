@@ -178,6 +178,7 @@ LogData;
 
 LogData *createLogData();
 void destroyLogData(ClientData clientData, Tcl_Interp * interp);
+int resetLogData(Tcl_Interp * interp, LogData * logData);
 
 
 /* ----------------------------------------------------------------------------
@@ -0,0 +1,779 @@
+/*
+ * mainthread.c -- thread of the main interpreter of mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include "interpool.h"
+#include "mainthread.h"
+#include "webutl.h"
+
+#ifndef APACHE2
+  #define AP_LOG_ERROR(server, ...) ap_log_printf(server, __VA_ARGS__);
+#else /* APACHE2 */
+  #define AP_LOG_ERROR(server, format, ...) ap_log_error(APLOG_MARK, APLOG_ERR, 0, server, format, ##__VA_ARGS__);
+#endif
+
+/* ----------------------------------------------------------------------------
+ * snapshot of published variables
+ * A reader pins the current snapshot by counting itself in readers while
+ * holding snapshotLock, and reads it without the lock. A replaced snapshot
+ * is freed by the publisher, under the same lock, once it has no readers.
+ * ------------------------------------------------------------------------- */
+
+typedef struct MainSnapshotValue
+{
+    int length;
+    char bytes[1];
+}
+MainSnapshotValue;
+
+typedef struct MainSnapshot
+{
+    Tcl_HashTable vars;		/* name -> MainSnapshotValue */
+    long readers;		/* threads reading this snapshot */
+    struct MainSnapshot *next;	/* list of replaced snapshots */
+}
+MainSnapshot;
+
+static MainSnapshot *mainSnapshot = NULL;
+static MainSnapshot *retiredSnapshots = NULL;
+static char *publishVars = NULL;	/* list of variable names */
+static int publishInterval = WEB_MAINPUBLISH_INTERVAL;
+static Tcl_TimerToken publishTimer = NULL;
+TCL_DECLARE_MUTEX(snapshotLock)
+
+/* ----------------------------------------------------------------------------
+ * the thread
+ * ------------------------------------------------------------------------- */
+
+static Tcl_ThreadId mainThreadId;
+static int mainThreadRunning = 0;
+static int mainThreadReady = 0;
+static int mainThreadQuit = 0;
+static long mainEvalId = 0;
+static Tcl_Condition mainThreadCond = NULL;
+TCL_DECLARE_MUTEX(mainThreadLock)
+
+/* ----------------------------------------------------------------------------
+ * replies of web::maineval -async -command
+ * The main thread appends them to the list of the calling interp and wakes
+ * its thread. They are delivered when that thread services events (vwait,
+ * update) or, at the latest, before the next request of the interp. The
+ * lists are protected by mainThreadLock, except next, which only the thread
+ * of the interp uses.
+ * ------------------------------------------------------------------------- */
+
+#define WEB_MAINREPLIES_ASSOC_DATA "web::mainReplies"
+
+typedef struct MainReply
+{
+    char *command;
+    long id;
+    int code;
+    char *result;
+    int length;
+    struct MainReply *next;
+}
+MainReply;
+
+typedef struct MainReplies
+{
+    Tcl_Interp *interp;		/* NULL: deleted */
+    websh_server_conf *conf;
+    int pending;		/* evals that will reply */
+    MainReply *first;
+    MainReply *last;
+    struct MainReplies *next;	/* of the same thread */
+}
+MainReplies;
+
+typedef struct MainThreadData
+{
+    MainReplies *replies;	/* of the interps of this thread */
+}
+MainThreadData;
+
+static Tcl_ThreadDataKey mainThreadDataKey;
+
+typedef struct MainEvalEvent
+{
+    Tcl_Event header;
+    websh_server_conf *conf;
+    char *code;
+    int length;
+    long id;
+    Tcl_ThreadId replyThread;
+    MainReplies *replies;	/* NULL: no callback */
+    char *command;
+}
+MainEvalEvent;
+
+static void publishTimerProc(ClientData clientData);
+
+/* ----------------------------------------------------------------------------
+ * copyBytes -- Tcl_Alloc'ed copy of length bytes (may contain NUL)
+ * ------------------------------------------------------------------------- */
+static char *copyBytes(const char *bytes, int length)
+{
+    char *copy = Tcl_Alloc(length + 1);
+
+    memcpy(copy, bytes, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/* ----------------------------------------------------------------------------
+ * freeSnapshot
+ * ------------------------------------------------------------------------- */
+static void freeSnapshot(MainSnapshot * snapshot)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+
+    for (hashEntry = Tcl_FirstHashEntry(&snapshot->vars, &search);
+	 hashEntry != NULL; hashEntry = Tcl_NextHashEntry(&search))
+	Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+    Tcl_DeleteHashTable(&snapshot->vars);
+    Tcl_Free((char *) snapshot);
+}
+
+/* ----------------------------------------------------------------------------
+ * addSnapshotValue
+ * ------------------------------------------------------------------------- */
+static void addSnapshotValue(MainSnapshot * snapshot, char *name, Tcl_Obj * valPtr)
+{
+    Tcl_HashEntry *hashEntry;
+    MainSnapshotValue *value;
+    char *bytes;
+    int length = 0;
+    int isNew = 0;
+
+    bytes = Tcl_GetStringFromObj(valPtr, &length);
+    value = (MainSnapshotValue *) Tcl_Alloc(sizeof(MainSnapshotValue) + length);
+    value->length = length;
+    memcpy(value->bytes, bytes, length);
+    value->bytes[length] = '\0';
+
+    hashEntry = Tcl_CreateHashEntry(&snapshot->vars, name, &isNew);
+    if (!isNew)
+	Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+    Tcl_SetHashValue(hashEntry, (ClientData) value);
+}
+
+/* ----------------------------------------------------------------------------
+ * publishSnapshot -- copy the selected variables of interp into a new
+ * snapshot and make it the current one. The caller owns interp. The
+ * snapshot is built without the lock (variable traces may run, even
+ * web::mainpublish), the lock is only taken to swap it in.
+ * ------------------------------------------------------------------------- */
+static void publishSnapshot(Tcl_Interp * interp)
+{
+    MainSnapshot *snapshot, *old, **retiredPtr;
+    CONST char **names = NULL;
+    char *vars = NULL;
+    int numnames = 0;
+    int res, i;
+
+    Tcl_MutexLock(&snapshotLock);
+    if (publishVars != NULL)
+	vars = allocAndSet(publishVars);
+    Tcl_MutexUnlock(&snapshotLock);
+
+    if (vars == NULL)
+	return;
+    res = Tcl_SplitList(NULL, vars, &numnames, &names);
+    Tcl_Free(vars);
+    if (res != TCL_OK)
+	return;
+
+    snapshot = (MainSnapshot *) Tcl_Alloc(sizeof(MainSnapshot));
+    Tcl_InitHashTable(&snapshot->vars, TCL_STRING_KEYS);
+    snapshot->readers = 0;
+    snapshot->next = NULL;
+
+    for (i = 0; i < numnames; i++) {
+	Tcl_Obj *valPtr = Tcl_GetVar2Ex(interp, names[i], NULL, TCL_GLOBAL_ONLY);
+
+	if (valPtr != NULL) {
+	    addSnapshotValue(snapshot, (char *) names[i], valPtr);
+	} else {
+	    /* an array: publish its elements as name(key) */
+	    Tcl_Obj *cmdList[3];
+	    Tcl_Obj *cmd;
+
+	    cmdList[0] = Tcl_NewStringObj("array", -1);
+	    cmdList[1] = Tcl_NewStringObj("get", -1);
+	    cmdList[2] = Tcl_NewStringObj(names[i], -1);
+	    cmd = Tcl_NewListObj(3, cmdList);
+	    Tcl_IncrRefCount(cmd);
+	    if (Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL) == TCL_OK) {
+		Tcl_Obj *resPtr = Tcl_GetObjResult(interp);
+		Tcl_Obj **elems = NULL;
+		int numelems = 0, j;
+
+		Tcl_IncrRefCount(resPtr);
+		if (Tcl_ListObjGetElements(NULL, resPtr, &numelems, &elems) == TCL_OK) {
+		    for (j = 0; j + 1 < numelems; j += 2) {
+			Tcl_DString key;
+
+			Tcl_DStringInit(&key);
+			Tcl_DStringAppend(&key, names[i], -1);
+			Tcl_DStringAppend(&key, "(", 1);
+			Tcl_DStringAppend(&key, Tcl_GetString(elems[j]), -1);
+			Tcl_DStringAppend(&key, ")", 1);
+			addSnapshotValue(snapshot, Tcl_DStringValue(&key), elems[j + 1]);
+			Tcl_DStringFree(&key);
+		    }
+		}
+		Tcl_DecrRefCount(resPtr);
+	    }
+	    Tcl_DecrRefCount(cmd);
+	}
+    }
+    Tcl_Free((char *) names);
+    Tcl_ResetResult(interp);
+
+    Tcl_MutexLock(&snapshotLock);
+
+    old = mainSnapshot;
+    mainSnapshot = snapshot;
+
+    if (old != NULL) {
+	old->next = retiredSnapshots;
+	retiredSnapshots = old;
+    }
+
+    /* free what nobody is reading any more, new readers cannot pin it */
+    retiredPtr = &retiredSnapshots;
+    while (*retiredPtr != NULL) {
+	MainSnapshot *retired = *retiredPtr;
+	if (retired->readers == 0) {
+	    *retiredPtr = retired->next;
+	    freeSnapshot(retired);
+	} else {
+	    retiredPtr = &retired->next;
+	}
+    }
+
+    Tcl_MutexUnlock(&snapshotLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * mainSnapshotGet -- set result of interp to the published value of name
+ * ------------------------------------------------------------------------- */
+int mainSnapshotGet(Tcl_Interp * interp, char *name)
+{
+    MainSnapshot *snapshot;
+    Tcl_HashEntry *hashEntry;
+    int res = TCL_OK;
+
+    /* pin it, the copy is made without the lock */
+    Tcl_MutexLock(&snapshotLock);
+    snapshot = mainSnapshot;
+    if (snapshot != NULL)
+	snapshot->readers++;
+    Tcl_MutexUnlock(&snapshotLock);
+
+    hashEntry = (snapshot != NULL) ? Tcl_FindHashEntry(&snapshot->vars, name) : NULL;
+    if (hashEntry != NULL) {
+	MainSnapshotValue *value = (MainSnapshotValue *) Tcl_GetHashValue(hashEntry);
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(value->bytes, value->length));
+    } else {
+	Tcl_ResetResult(interp);
+	Tcl_AppendResult(interp, "no such published variable \"", name, "\"",
+			 (char *) NULL);
+	res = TCL_ERROR;
+    }
+
+    if (snapshot != NULL) {
+	Tcl_MutexLock(&snapshotLock);
+	snapshot->readers--;
+	Tcl_MutexUnlock(&snapshotLock);
+    }
+
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * publishTimerProc -- periodic publish in the main thread
+ * ------------------------------------------------------------------------- */
+static void publishTimerProc(ClientData clientData)
+{
+    websh_server_conf *conf = (websh_server_conf *) clientData;
+
+    Tcl_MutexLock(&(conf->mainInterpLock));
+    if (conf->mainInterp != NULL)
+	publishSnapshot(conf->mainInterp);
+    Tcl_MutexUnlock(&(conf->mainInterpLock));
+
+    publishTimer = Tcl_CreateTimerHandler(publishInterval, publishTimerProc, clientData);
+}
+
+/* ----------------------------------------------------------------------------
+ * web::mainpublish ?-interval ms? ?varName ...?
+ * Only the main interp of the process publishes (clientData is the conf),
+ * the main interps of the thread pools accept the command and ignore it.
+ * ------------------------------------------------------------------------- */
+int Web_MainPublish(ClientData clientData,
+		    Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+    websh_server_conf *conf = (websh_server_conf *) clientData;
+    int first = 1;
+    int interval = -1;
+
+    if (objc >= 3 && !strcmp(Tcl_GetString(objv[1]), "-interval")) {
+	if (Tcl_GetIntFromObj(interp, objv[2], &interval) != TCL_OK)
+	    return TCL_ERROR;
+	if (interval <= 0) {
+	    Tcl_SetResult(interp, "interval must be positive", NULL);
+	    return TCL_ERROR;
+	}
+	first = 3;
+    }
+
+    if (conf == NULL)
+	return TCL_OK;
+
+    Tcl_MutexLock(&snapshotLock);
+    if (interval > 0)
+	publishInterval = interval;
+    if (objc > first) {
+	Tcl_Obj *listPtr = Tcl_NewListObj(objc - first, objv + first);
+	Tcl_IncrRefCount(listPtr);
+	if (publishVars != NULL)
+	    Tcl_Free(publishVars);
+	publishVars = allocAndSet(Tcl_GetString(listPtr));
+	Tcl_DecrRefCount(listPtr);
+    }
+    Tcl_MutexUnlock(&snapshotLock);
+
+    /* the caller owns interp, publish right away */
+    publishSnapshot(interp);
+
+    Tcl_MutexLock(&snapshotLock);
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(publishVars != NULL ? publishVars : "", -1));
+    Tcl_MutexUnlock(&snapshotLock);
+
+    /* the timer runs in the main thread only */
+    if (publishTimer == NULL && mainThreadRunning
+	&& Tcl_GetCurrentThread() == mainThreadId)
+	publishTimer = Tcl_CreateTimerHandler(publishInterval, publishTimerProc, clientData);
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * freeReply
+ * ------------------------------------------------------------------------- */
+static void freeReply(MainReply * reply)
+{
+    Tcl_Free(reply->command);
+    Tcl_Free(reply->result);
+    Tcl_Free((char *) reply);
+}
+
+/* ----------------------------------------------------------------------------
+ * deleteMainReplies -- the interp is deleted (thread of the interp)
+ * ------------------------------------------------------------------------- */
+static void deleteMainReplies(ClientData clientData, Tcl_Interp * interp)
+{
+    MainReplies *replies = (MainReplies *) clientData;
+    MainThreadData *tsdPtr = (MainThreadData *)
+	Tcl_GetThreadData(&mainThreadDataKey, sizeof(MainThreadData));
+    MainReplies **repliesPtr;
+    MainReply *reply;
+    int unused;
+
+    for (repliesPtr = &tsdPtr->replies; *repliesPtr != NULL;
+	 repliesPtr = &(*repliesPtr)->next) {
+	if (*repliesPtr == replies) {
+	    *repliesPtr = replies->next;
+	    break;
+	}
+    }
+
+    Tcl_MutexLock(&mainThreadLock);
+    while ((reply = replies->first) != NULL) {
+	replies->first = reply->next;
+	freeReply(reply);
+    }
+    replies->last = NULL;
+    replies->interp = NULL;
+    /* otherwise freed by the main thread with the last reply */
+    unused = (replies->pending == 0);
+    Tcl_MutexUnlock(&mainThreadLock);
+
+    if (unused)
+	Tcl_Free((char *) replies);
+}
+
+/* ----------------------------------------------------------------------------
+ * getMainReplies -- reply list of interp, created on first use
+ * ------------------------------------------------------------------------- */
+static MainReplies *getMainReplies(websh_server_conf * conf,
+				   Tcl_Interp * interp)
+{
+    MainReplies *replies;
+    MainThreadData *tsdPtr;
+
+    replies = (MainReplies *)
+	Tcl_GetAssocData(interp, WEB_MAINREPLIES_ASSOC_DATA, NULL);
+    if (replies != NULL)
+	return replies;
+
+    tsdPtr = (MainThreadData *)
+	Tcl_GetThreadData(&mainThreadDataKey, sizeof(MainThreadData));
+
+    replies = (MainReplies *) Tcl_Alloc(sizeof(MainReplies));
+    replies->interp = interp;
+    replies->conf = conf;
+    replies->pending = 0;
+    replies->first = NULL;
+    replies->last = NULL;
+    replies->next = tsdPtr->replies;
+    tsdPtr->replies = replies;
+
+    Tcl_SetAssocData(interp, WEB_MAINREPLIES_ASSOC_DATA, deleteMainReplies,
+		     (ClientData) replies);
+    return replies;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainThreadDeliverReplies -- call the -command callbacks whose code was
+ * evaluated by the main interp (thread of interp)
+ * ------------------------------------------------------------------------- */
+void mainThreadDeliverReplies(Tcl_Interp * interp)
+{
+    MainReplies *replies;
+    MainReply *reply, *next;
+    websh_server_conf *conf;
+
+    replies = (MainReplies *)
+	Tcl_GetAssocData(interp, WEB_MAINREPLIES_ASSOC_DATA, NULL);
+    if (replies == NULL)
+	return;
+
+    Tcl_MutexLock(&mainThreadLock);
+    reply = replies->first;
+    replies->first = NULL;
+    replies->last = NULL;
+    conf = replies->conf;
+    Tcl_MutexUnlock(&mainThreadLock);
+
+    /* a callback may delete interp */
+    Tcl_Preserve((ClientData) interp);
+
+    for (; reply != NULL; reply = next) {
+	next = reply->next;
+	if (!Tcl_InterpDeleted(interp)) {
+	    Tcl_Obj *cmd = Tcl_NewStringObj(reply->command, -1);
+
+	    Tcl_IncrRefCount(cmd);
+	    Tcl_ListObjAppendElement(NULL, cmd, Tcl_NewLongObj(reply->id));
+	    Tcl_ListObjAppendElement(NULL, cmd, Tcl_NewIntObj(reply->code));
+	    Tcl_ListObjAppendElement(NULL, cmd,
+				     Tcl_NewStringObj(reply->result, reply->length));
+	    if (Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL) != TCL_OK)
+		AP_LOG_ERROR(conf->server, "web::maineval -command: %s",
+			     Tcl_GetVar(interp, "errorInfo", TCL_GLOBAL_ONLY));
+	    Tcl_ResetResult(interp);
+	    Tcl_DecrRefCount(cmd);
+	}
+	freeReply(reply);
+    }
+
+    Tcl_Release((ClientData) interp);
+}
+
+/* ----------------------------------------------------------------------------
+ * mainWakeProc -- replies arrived while the thread services events
+ * ------------------------------------------------------------------------- */
+static int mainWakeProc(Tcl_Event * evPtr, int flags)
+{
+    MainThreadData *tsdPtr = (MainThreadData *)
+	Tcl_GetThreadData(&mainThreadDataKey, sizeof(MainThreadData));
+    MainReplies *replies;
+    Tcl_Interp **interps;
+    int count = 0, i;
+
+    /* callbacks may create and delete interps, collect them first */
+    for (replies = tsdPtr->replies; replies != NULL; replies = replies->next)
+	count++;
+    if (count == 0)
+	return 1;
+
+    interps = (Tcl_Interp **) Tcl_Alloc(count * sizeof(Tcl_Interp *));
+    for (i = 0, replies = tsdPtr->replies; replies != NULL;
+	 replies = replies->next, i++) {
+	interps[i] = replies->interp;
+	Tcl_Preserve((ClientData) interps[i]);
+    }
+
+    for (i = 0; i < count; i++) {
+	if (!Tcl_InterpDeleted(interps[i]))
+	    mainThreadDeliverReplies(interps[i]);
+	Tcl_Release((ClientData) interps[i]);
+    }
+    Tcl_Free((char *) interps);
+
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainEvalProc -- eval code of web::maineval -async (main thread)
+ * ------------------------------------------------------------------------- */
+static int mainEvalProc(Tcl_Event * evPtr, int flags)
+{
+    MainEvalEvent *eventPtr = (MainEvalEvent *) evPtr;
+    websh_server_conf *conf = eventPtr->conf;
+    MainReply *reply = NULL;
+    int res = TCL_ERROR;
+
+    if (eventPtr->replies != NULL) {
+	reply = (MainReply *) Tcl_Alloc(sizeof(MainReply));
+	reply->command = eventPtr->command;
+	reply->id = eventPtr->id;
+	reply->next = NULL;
+    }
+
+    Tcl_MutexLock(&(conf->mainInterpLock));
+
+    if (conf->mainInterp != NULL) {
+	res = Tcl_EvalEx(conf->mainInterp, eventPtr->code, eventPtr->length,
+			 TCL_EVAL_GLOBAL);
+
+	if (reply != NULL) {
+	    char *bytes;
+	    int length = 0;
+
+	    bytes = Tcl_GetStringFromObj(Tcl_GetObjResult(conf->mainInterp),
+					 &length);
+	    reply->result = copyBytes(bytes, length);
+	    reply->length = length;
+	} else if (res == TCL_ERROR) {
+	    /* nobody will see it otherwise */
+	    AP_LOG_ERROR(conf->server, "web::maineval -async: %s",
+			 Tcl_GetVar(conf->mainInterp, "errorInfo", TCL_GLOBAL_ONLY));
+	}
+	Tcl_ResetResult(conf->mainInterp);
+    } else if (reply != NULL) {
+	reply->result = allocAndSet("main interp is gone");
+	reply->length = strlen(reply->result);
+    }
+
+    Tcl_MutexUnlock(&(conf->mainInterpLock));
+
+    if (reply != NULL) {
+	MainReplies *replies = eventPtr->replies;
+	int wake = 0, unused = 0;
+
+	reply->code = res;
+
+	Tcl_MutexLock(&mainThreadLock);
+	replies->pending--;
+	if (replies->interp != NULL) {
+	    if (replies->last != NULL)
+		replies->last->next = reply;
+	    else
+		replies->first = reply;
+	    replies->last = reply;
+	    wake = 1;
+	} else {
+	    unused = (replies->pending == 0);
+	}
+	Tcl_MutexUnlock(&mainThreadLock);
+
+	if (wake) {
+	    Tcl_Event *wakePtr = (Tcl_Event *) Tcl_Alloc(sizeof(Tcl_Event));
+
+	    wakePtr->proc = mainWakeProc;
+	    Tcl_ThreadQueueEvent(eventPtr->replyThread, wakePtr,
+				 TCL_QUEUE_TAIL);
+	    Tcl_ThreadAlert(eventPtr->replyThread);
+	} else {
+	    /* the interp is gone */
+	    freeReply(reply);
+	    if (unused)
+		Tcl_Free((char *) replies);
+	}
+    }
+    Tcl_Free(eventPtr->code);
+
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainThreadEvalAsync -- queue code for the main interp, set result of
+ * interp to the id of the request. If command is given, it is called in
+ * interp with id, return code and result appended (see
+ * mainThreadDeliverReplies).
+ * ------------------------------------------------------------------------- */
+int mainThreadEvalAsync(websh_server_conf * conf, Tcl_Interp * interp,
+			Tcl_Obj * code, Tcl_Obj * command)
+{
+    MainEvalEvent *eventPtr;
+    char *bytes;
+    int length = 0;
+    long id;
+
+    Tcl_MutexLock(&mainThreadLock);
+    id = ++mainEvalId;
+    Tcl_MutexUnlock(&mainThreadLock);
+
+    bytes = Tcl_GetStringFromObj(code, &length);
+
+    eventPtr = (MainEvalEvent *) Tcl_Alloc(sizeof(MainEvalEvent));
+    eventPtr->header.proc = mainEvalProc;
+    eventPtr->conf = conf;
+    eventPtr->code = copyBytes(bytes, length);
+    eventPtr->length = length;
+    eventPtr->id = id;
+    eventPtr->replyThread = Tcl_GetCurrentThread();
+    eventPtr->replies = NULL;
+    eventPtr->command = NULL;
+
+    if (command != NULL) {
+	eventPtr->replies = getMainReplies(conf, interp);
+	eventPtr->command = allocAndSet(Tcl_GetString(command));
+	Tcl_MutexLock(&mainThreadLock);
+	eventPtr->replies->pending++;
+	Tcl_MutexUnlock(&mainThreadLock);
+    }
+
+    if (mainThreadRunning) {
+	Tcl_ThreadQueueEvent(mainThreadId, (Tcl_Event *) eventPtr, TCL_QUEUE_TAIL);
+	Tcl_ThreadAlert(mainThreadId);
+    } else {
+	/* no main thread: eval now, the callback is delivered as usual */
+	mainEvalProc((Tcl_Event *) eventPtr, TCL_ALL_EVENTS);
+	Tcl_Free((char *) eventPtr);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewLongObj(id));
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainQuitProc
+ * ------------------------------------------------------------------------- */
+static int mainQuitProc(Tcl_Event * evPtr, int flags)
+{
+    mainThreadQuit = 1;
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainThreadProc -- create the main interp and serve events until quit
+ * ------------------------------------------------------------------------- */
+static Tcl_ThreadCreateType mainThreadProc(ClientData clientData)
+{
+    websh_server_conf *conf = (websh_server_conf *) clientData;
+    Tcl_Interp *mainInterp;
+
+    mainInterp = createMainInterp(conf, conf->webshPool);
+
+    Tcl_MutexLock(&mainThreadLock);
+    conf->mainInterp = mainInterp;
+    mainThreadReady = 1;
+    Tcl_ConditionNotify(&mainThreadCond);
+    Tcl_MutexUnlock(&mainThreadLock);
+
+    if (mainInterp != NULL) {
+	if (publishVars != NULL && publishTimer == NULL)
+	    publishTimer = Tcl_CreateTimerHandler(publishInterval,
+						  publishTimerProc, clientData);
+
+	while (!mainThreadQuit)
+	    Tcl_DoOneEvent(TCL_ALL_EVENTS);
+
+	if (publishTimer != NULL) {
+	    Tcl_DeleteTimerHandler(publishTimer);
+	    publishTimer = NULL;
+	}
+
+	Tcl_MutexLock(&(conf->mainInterpLock));
+	conf->mainInterp = NULL;
+	Tcl_DeleteInterp(mainInterp);
+	Tcl_MutexUnlock(&(conf->mainInterpLock));
+    }
+
+    Tcl_ExitThread(TCL_OK);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainThreadStart -- create conf->mainInterp in a thread of its own.
+ * Returns 0 if there is no such thread (the caller creates the main interp
+ * itself), else 1 (conf->mainInterp is NULL if it could not be created).
+ * ------------------------------------------------------------------------- */
+int mainThreadStart(websh_server_conf * conf)
+{
+    int result;
+
+    Tcl_MutexLock(&mainThreadLock);
+
+    mainThreadReady = 0;
+    mainThreadQuit = 0;
+    if (Tcl_CreateThread(&mainThreadId, mainThreadProc, (ClientData) conf,
+			 TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK) {
+	Tcl_MutexUnlock(&mainThreadLock);
+	return 0;
+    }
+    while (!mainThreadReady)
+	Tcl_ConditionWait(&mainThreadCond, &mainThreadLock, NULL);
+    mainThreadRunning = (conf->mainInterp != NULL);
+
+    Tcl_MutexUnlock(&mainThreadLock);
+
+    if (!mainThreadRunning)
+	Tcl_JoinThread(mainThreadId, &result);
+
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * mainThreadStop -- delete the main interp in its thread, free snapshots
+ * ------------------------------------------------------------------------- */
+void mainThreadStop(websh_server_conf * conf)
+{
+    Tcl_Event *evPtr;
+    MainSnapshot *snapshot;
+    int result;
+
+    if (mainThreadRunning) {
+	evPtr = (Tcl_Event *) Tcl_Alloc(sizeof(Tcl_Event));
+	evPtr->proc = mainQuitProc;
+	Tcl_ThreadQueueEvent(mainThreadId, evPtr, TCL_QUEUE_TAIL);
+	Tcl_ThreadAlert(mainThreadId);
+	Tcl_JoinThread(mainThreadId, &result);
+	mainThreadRunning = 0;
+    }
+
+    Tcl_MutexLock(&snapshotLock);
+    snapshot = mainSnapshot;
+    mainSnapshot = NULL;
+    if (snapshot != NULL)
+	freeSnapshot(snapshot);
+    while ((snapshot = retiredSnapshots) != NULL) {
+	retiredSnapshots = snapshot->next;
+	freeSnapshot(snapshot);
+    }
+    if (publishVars != NULL) {
+	Tcl_Free(publishVars);
+	publishVars = NULL;
+    }
+    publishInterval = WEB_MAINPUBLISH_INTERVAL;
+    Tcl_MutexUnlock(&snapshotLock);
+}
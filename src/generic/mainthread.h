@@ -0,0 +1,45 @@
+/*
+ * mainthread.h -- thread of the main interpreter of mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_MAINTHREAD_H
+#define WEB_MAINTHREAD_H
+
+#include "tcl.h"
+#include "mod_websh.h"
+
+/* ----------------------------------------------------------------------------
+ * the main interp of the process lives in a thread of its own that runs
+ * the Tcl event loop.
+ * - web::maineval -async posts the code to that thread as a Tcl event,
+ *   the caller does not wait for the main interp
+ * - web::mainpublish (in the main interp) selects variables that are
+ *   copied into a snapshot periodically. web::maineval -readonly reads
+ *   the latest snapshot without waiting for the main interp
+ * ------------------------------------------------------------------------- */
+
+#define WEB_MAINPUBLISH_INTERVAL 1000	/* default interval (ms) */
+
+int mainThreadStart(websh_server_conf * conf);
+void mainThreadStop(websh_server_conf * conf);
+
+int mainThreadEvalAsync(websh_server_conf * conf, Tcl_Interp * interp,
+			Tcl_Obj * code, Tcl_Obj * command);
+void mainThreadDeliverReplies(Tcl_Interp * interp);
+int mainSnapshotGet(Tcl_Interp * interp, char *name);
+
+int Web_MainPublish(ClientData clientData,
+		    Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+
+#endif
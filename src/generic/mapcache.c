@@ -0,0 +1,124 @@
+/*
+ * mapcache.c -- process-wide cache of web::interpmap results for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include "hashutl.h"
+#include "webutl.h"
+#include "mapcache.h"
+
+static Tcl_HashTable *mapCache = NULL;
+static long mapGeneration = 0;
+TCL_DECLARE_MUTEX(mapCacheLock)
+
+/* ----------------------------------------------------------------------------
+ * clearMapCache (locked)
+ * ------------------------------------------------------------------------- */
+static void clearMapCache(void)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+
+    while ((hashEntry = Tcl_FirstHashEntry(mapCache, &search)) != NULL) {
+	Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+	Tcl_DeleteHashEntry(hashEntry);
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * mapCacheGet -- class id for filename (new copy, Tcl_Free it) or NULL
+ * ------------------------------------------------------------------------- */
+char *mapCacheGet(const char *filename)
+{
+    Tcl_HashEntry *hashEntry;
+    char *classid = NULL;
+
+    Tcl_MutexLock(&mapCacheLock);
+
+    if (mapCache != NULL) {
+	hashEntry = Tcl_FindHashEntry(mapCache, filename);
+	if (hashEntry != NULL)
+	    classid = allocAndSet((char *) Tcl_GetHashValue(hashEntry));
+    }
+
+    Tcl_MutexUnlock(&mapCacheLock);
+
+    return classid;
+}
+
+/* ----------------------------------------------------------------------------
+ * mapCachePut -- remember that filename is mapped to classid
+ * ------------------------------------------------------------------------- */
+void mapCachePut(const char *filename, const char *classid)
+{
+    Tcl_HashEntry *hashEntry;
+    int isNew = 0;
+
+    Tcl_MutexLock(&mapCacheLock);
+
+    if (mapCache == NULL) {
+	HashUtlAllocInit(mapCache, TCL_STRING_KEYS);
+    }
+
+    if (mapCache->numEntries >= WEB_MAPCACHE_MAX) {
+	/* requests for ever new file names must not grow the cache */
+	clearMapCache();
+    }
+
+    hashEntry = Tcl_CreateHashEntry(mapCache, filename, &isNew);
+    if (!isNew)
+	Tcl_Free((char *) Tcl_GetHashValue(hashEntry));
+    Tcl_SetHashValue(hashEntry, (ClientData) allocAndSet(classid));
+
+    Tcl_MutexUnlock(&mapCacheLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * mapCacheGeneration -- changes whenever the cache is flushed
+ * ------------------------------------------------------------------------- */
+long mapCacheGeneration(void)
+{
+    long generation;
+
+#ifdef __GNUC__
+    generation = __atomic_load_n(&mapGeneration, __ATOMIC_ACQUIRE);
+#else
+    Tcl_MutexLock(&mapCacheLock);
+    generation = mapGeneration;
+    Tcl_MutexUnlock(&mapCacheLock);
+#endif
+
+    return generation;
+}
+
+/* ----------------------------------------------------------------------------
+ * mapCacheFlush -- forget all mappings (config reloaded)
+ * ------------------------------------------------------------------------- */
+void mapCacheFlush(void)
+{
+    Tcl_MutexLock(&mapCacheLock);
+
+    if (mapCache != NULL) {
+	clearMapCache();
+	HashUtlDelFree(mapCache);
+	mapCache = NULL;
+    }
+#ifdef __GNUC__
+    __atomic_add_fetch(&mapGeneration, 1, __ATOMIC_RELEASE);
+#else
+    mapGeneration++;
+#endif
+
+    Tcl_MutexUnlock(&mapCacheLock);
+}
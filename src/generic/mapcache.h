@@ -0,0 +1,37 @@
+/*
+ * mapcache.h -- process-wide cache of web::interpmap results for mod_websh
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_MAPCACHE_H
+#define WEB_MAPCACHE_H
+
+#include "tcl.h"
+
+/* ----------------------------------------------------------------------------
+ * the cache is shared by all threads of the process.
+ * - key is the requested file name
+ * - entry is the id (= file name) of the interp class it is mapped to
+ * Threads keep their own copy of the entries they use and drop it when the
+ * generation has changed, so lookups of known files take no lock.
+ * The cache is flushed completely once it holds WEB_MAPCACHE_MAX entries.
+ * ------------------------------------------------------------------------- */
+
+#define WEB_MAPCACHE_MAX 4096
+
+char *mapCacheGet(const char *filename);
+void mapCachePut(const char *filename, const char *classid);
+long mapCacheGeneration(void);
+void mapCacheFlush(void);
+
+#endif
@@ -75,6 +75,7 @@
 #include "web.h"		/* websh headers */
 #include "mod_websh.h"		/* apache stuff */
 #include "interpool.h"
+#include "mainthread.h"
 #include "logtoap.h"
 
 #define WEBSH_HANDLER "websh"
@@ -126,6 +127,17 @@ static void *create_websh_config(APPOOL * pool, server_rec * s)
     conf->mainInterpLock = NULL;
     conf->webshPool = NULL;
     conf->webshPoolLock = NULL;
+    conf->prestartClasses = NULL;
+    conf->reaperInterval = 10;
+    conf->reaperMaxTime = 50;
+    conf->reaperTrim = 0;
+    conf->watchFiles = 0;
+    conf->serverTiming = 0;
+    conf->limitStatus = HTTP_INTERNAL_SERVER_ERROR;
+    conf->maxInterps = 0;
+    conf->interpMapRules = NULL;
+    conf->classDefaults = NULL;
+    conf->customInterpMap = 0;
     conf->server = s;
 
     apr_pool_cleanup_register(pool, conf, cleanup_websh_pool, apr_pool_cleanup_null);
@@ -157,6 +169,109 @@ static const char *set_webshscript(cmd_parms * cmd, void *dummy, const char *arg
     return NULL;
 }
 
+static const char *set_webshprestart(cmd_parms * cmd, void *dummy, const char *arg)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+
+    if (conf->prestartClasses == NULL)
+	conf->prestartClasses = apr_array_make(cmd->pool, 4, sizeof(char *));
+
+    *(const char **) apr_array_push(conf->prestartClasses) =
+	ap_server_root_relative(cmd->pool, arg);
+
+    return NULL;
+}
+
+static const char *set_webshreaper(cmd_parms * cmd, void *dummy, const char *arg)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+    char *end = NULL;
+    long value = strtol(arg, &end, 10);
+
+    if (end == arg || *end != '\0' || value < 0)
+	return "argument must be a non-negative number";
+
+    if (cmd->info == (void *) 2)
+	conf->maxInterps = value;
+    else if (cmd->info == (void *) 1)
+	conf->reaperMaxTime = value;
+    else
+	conf->reaperInterval = value;
+
+    return NULL;
+}
+
+static const char *set_webshreapertrim(cmd_parms * cmd, void *dummy, int flag)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+
+    conf->reaperTrim = flag;
+
+    return NULL;
+}
+
+static const char *set_webshinterpmap(cmd_parms * cmd, void *dummy,
+				      const char *pattern, const char *classid)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+    websh_interpmap_rule *rule;
+
+    if (conf->interpMapRules == NULL)
+	conf->interpMapRules = apr_array_make(cmd->pool, 4, sizeof(websh_interpmap_rule));
+
+    rule = (websh_interpmap_rule *) apr_array_push(conf->interpMapRules);
+    rule->pattern = pattern;
+    rule->classid = ap_server_root_relative(cmd->pool, classid);
+
+    return NULL;
+}
+
+static const char *set_webshwatchfiles(cmd_parms * cmd, void *dummy, int flag)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+
+    conf->watchFiles = flag;
+
+    return NULL;
+}
+
+static const char *set_webshlimitstatus(cmd_parms * cmd, void *dummy, const char *arg)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+    char *end = NULL;
+    long value = strtol(arg, &end, 10);
+
+    if (end == arg || *end != '\0' || value < 400 || value > 599)
+	return "argument must be an HTTP error status (400-599)";
+
+    conf->limitStatus = (int) value;
+
+    return NULL;
+}
+
+static const char *set_webshservertiming(cmd_parms * cmd, void *dummy, int flag)
+{
+    server_rec *s = cmd->server;
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(s->module_config, &websh_module);
+
+    conf->serverTiming = flag;
+
+    return NULL;
+}
+
 #ifdef APACHE2
 static void websh_init_child(apr_pool_t * p, server_rec * s)
 {
@@ -189,6 +304,24 @@ static void websh_init_child(server_rec *s, pool *p)
 static const command_rec websh_cmds[] = {
     {"WebshConfig", CMDFUNC set_webshscript, NULL, RSRC_CONF, TAKE1,
      "the name of the main websh configuration file"},
+    {"WebshPrestart", CMDFUNC set_webshprestart, NULL, RSRC_CONF, ITERATE,
+     "interpreter classes to create when a worker thread starts"},
+    {"WebshReaperInterval", CMDFUNC set_webshreaper, (void *) 0, RSRC_CONF, TAKE1,
+     "seconds between two sweeps for expired interpreters (0: after every request)"},
+    {"WebshReaperMaxTime", CMDFUNC set_webshreaper, (void *) 1, RSRC_CONF, TAKE1,
+     "maximum milliseconds spent destroying interpreters per sweep (0: unlimited)"},
+    {"WebshReaperTrim", CMDFUNC set_webshreapertrim, NULL, RSRC_CONF, FLAG,
+     "return freed memory to the system after interpreters were destroyed"},
+    {"WebshInterpMap", CMDFUNC set_webshinterpmap, NULL, RSRC_CONF, TAKE2,
+     "glob pattern of requested files and the interpreter class to use for them"},
+    {"WebshWatchFiles", CMDFUNC set_webshwatchfiles, NULL, RSRC_CONF, FLAG,
+     "reload scripts when the file watcher reports a change instead of checking their mtime"},
+    {"WebshServerTiming", CMDFUNC set_webshservertiming, NULL, RSRC_CONF, FLAG,
+     "send the time spent in the phases of a request as Server-Timing header"},
+    {"WebshMaxInterps", CMDFUNC set_webshreaper, (void *) 2, RSRC_CONF, TAKE1,
+     "maximum number of interpreters of the process, least recently used free ones are evicted (0: unlimited)"},
+    {"WebshLimitStatus", CMDFUNC set_webshlimitstatus, NULL, RSRC_CONF, TAKE1,
+     "HTTP status of a request whose script exceeded maxexectime or maxcommands"},
     {NULL}
 };
 
@@ -208,6 +341,87 @@ static apr_status_t release_webinterp(void *data) {
     poolReleaseThreadWebInterp(webInterp);
 }
 
+/* ----------------------------------------------------------------------------
+ * script limits -- maxexectime and maxcommands of the class (Tcl 8.5)
+ * the time limit is checked between commands, a script blocked in a
+ * command is not interrupted
+ * ------------------------------------------------------------------------- */
+#if TCL_MAJOR_VERSION > 8 || (TCL_MAJOR_VERSION == 8 && TCL_MINOR_VERSION >= 5)
+#define WEB_SCRIPT_LIMITS
+#endif
+
+static void setScriptLimits(WebInterp * webInterp)
+{
+#ifdef WEB_SCRIPT_LIMITS
+    WebInterpClass *webInterpClass = webInterp->interpClass;
+    Tcl_Interp *interp = webInterp->interp;
+
+    if (webInterpClass->maxexectime > 0) {
+	Tcl_Time limit;
+
+	Tcl_GetTime(&limit);
+	limit.sec += webInterpClass->maxexectime / 1000;
+	limit.usec += (webInterpClass->maxexectime % 1000) * 1000;
+	if (limit.usec >= 1000000) {
+	    limit.sec++;
+	    limit.usec -= 1000000;
+	}
+	Tcl_LimitSetTime(interp, &limit);
+	Tcl_LimitTypeSet(interp, TCL_LIMIT_TIME);
+    }
+
+    if (webInterpClass->maxcommands > 0) {
+	int cmdcount = 0;
+
+	/* the limit counts the commands since the interp was created */
+	if (Tcl_Eval(interp, "info cmdcount") == TCL_OK)
+	    Tcl_GetIntFromObj(NULL, Tcl_GetObjResult(interp), &cmdcount);
+	Tcl_ResetResult(interp);
+	Tcl_LimitSetCommands(interp, cmdcount + (int) webInterpClass->maxcommands);
+	Tcl_LimitTypeSet(interp, TCL_LIMIT_COMMANDS);
+    }
+#endif /* WEB_SCRIPT_LIMITS */
+}
+
+/* remove the limits, returns 1 if one of them was exceeded */
+static int clearScriptLimits(WebInterp * webInterp)
+{
+#ifdef WEB_SCRIPT_LIMITS
+    int exceeded = Tcl_LimitExceeded(webInterp->interp);
+
+    Tcl_LimitTypeReset(webInterp->interp, TCL_LIMIT_TIME);
+    Tcl_LimitTypeReset(webInterp->interp, TCL_LIMIT_COMMANDS);
+
+    return exceeded;
+#else /* WEB_SCRIPT_LIMITS */
+    return 0;
+#endif /* WEB_SCRIPT_LIMITS */
+}
+
+/* ----------------------------------------------------------------------------
+ * finish_response -- end of stream, flushed to the client. What is done
+ * afterwards in the handler does not delay the response.
+ * ------------------------------------------------------------------------- */
+static apr_status_t finish_response(request_rec * r)
+{
+    apr_bucket_brigade *bb;
+    apr_status_t rv;
+
+    bb = apr_brigade_create(r->pool, r->connection->bucket_alloc);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(r->connection->bucket_alloc));
+    rv = ap_pass_brigade(r->output_filters, bb);
+    apr_brigade_cleanup(bb);
+    if (rv != APR_SUCCESS)
+	return rv;
+
+    /* nothing is sent after the end of stream, write everything now */
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(r->connection->bucket_alloc));
+    rv = ap_pass_brigade(r->output_filters, bb);
+    apr_brigade_cleanup(bb);
+
+    return rv;
+}
+
 static int websh_run_script(request_rec * r)
 {
 
@@ -215,14 +429,14 @@ static int websh_run_script(request_rec * r)
     websh_server_conf *conf =
 	(websh_server_conf *) ap_get_module_config(r->server->module_config,
 						   &websh_module);
-    // TODO: script timeout check
-    /* checkme: check type of timeout in MP case */
-    /* ap_soft_timeout("!!! timeout for run_websh_script expired", r); */
+    long timing[WIP_PHASE_NUM];
+    long handlerTime = (long) apr_time_now();
+    int status;
 
-    webInterp = poolGetThreadWebInterp(conf, r->filename, (long) r->finfo.mtime, r);
+    webInterp = poolGetThreadWebInterp(conf, r->filename, (long) r->finfo.mtime, r, &status);
 
     if (webInterp == NULL){
-	return HTTP_INTERNAL_SERVER_ERROR;
+	return status;
     }
 
 
@@ -231,7 +445,12 @@ static int websh_run_script(request_rec * r)
     webInterp->time_request = r->request_time;
     webInterp->time_ready   = apr_time_now();
 
-    int status = OK;
+    memset(webInterp->timing, 0, sizeof(webInterp->timing));
+    webInterp->timing[WIP_PHASE_REQUEST]  = webInterp->time_request;
+    webInterp->timing[WIP_PHASE_HANDLER]  = handlerTime;
+    webInterp->timing[WIP_PHASE_ACQUIRED] = webInterp->time_ready;
+
+    status = OK;
     do {
 
       if (createApchannel(webInterp->interp, r) != TCL_OK) {
@@ -248,17 +467,23 @@ static int websh_run_script(request_rec * r)
 
       //-------------------------------------------------------//
 
-      if (Tcl_Eval(webInterp->interp, "web::ap::perReqInit") != TCL_OK) {
+      if (webResetRequest(webInterp->interp, WEB_RESET_INIT) != TCL_OK) {
           expireWebInterp(webInterp);  // XXX: mark this interp as expired
 
 	  AP_LOG_RERROR(r, "mod_websh - cannot init per-request Websh code: %s", Tcl_GetStringResult(webInterp->interp));
 	  status = HTTP_INTERNAL_SERVER_ERROR;
           break;
       }
+      webInterp->timing[WIP_PHASE_INIT] = (long) apr_time_now();
+
+      /* web::maineval -async -command callbacks not delivered yet */
+      mainThreadDeliverReplies(webInterp->interp);
 
 
       int res;
 
+      setScriptLimits(webInterp);
+
       if(Tcl_FindCommand(webInterp->interp, "web::start", NULL, TCL_GLOBAL_ONLY)!=NULL){
         res = Tcl_Eval(webInterp->interp, "web::start");
       }else{
@@ -266,6 +491,19 @@ static int websh_run_script(request_rec * r)
         res = Tcl_EvalObjEx(webInterp->interp, webInterp->code, 0);
         Tcl_DecrRefCount(webInterp->code);
       }
+      webInterp->timing[WIP_PHASE_SCRIPT] = (long) apr_time_now();
+
+      if (clearScriptLimits(webInterp)) {
+	  expireWebInterpFor(webInterp, WIP_EXPIRY_LIMIT);
+
+	  AP_LOG_RERROR(r, "mod_websh - script %s exceeded its limits (maxexectime %ld ms, maxcommands %ld)",
+			r->filename, webInterp->interpClass->maxexectime,
+			webInterp->interpClass->maxcommands);
+
+	  /* the status can only be changed before the headers went out */
+	  if (!webInterp->timing[WIP_PHASE_FIRSTBYTE])
+	      status = conf->limitStatus;
+      }
 
       if (res != TCL_OK) {
 	  expireWebInterp(webInterp);  // XXX: mark this interp as expired
@@ -284,13 +522,11 @@ static int websh_run_script(request_rec * r)
 
       Tcl_ResetResult(webInterp->interp);
 
-      if (Tcl_Eval(webInterp->interp, "web::ap::perReqCleanup") != TCL_OK) {
-          expireWebInterp(webInterp);  // XXX: mark this interp as expired
-	  AP_LOG_RERROR(r, "mod_websh - error while cleaning-up: %s", Tcl_GetStringResult(webInterp->interp));
-	  status = HTTP_INTERNAL_SERVER_ERROR;
-      }
-      //-------------------------------------------------------//
+      /* what is still in the output buffer goes to the channel first */
+      if (flushAllResponseObjs(webInterp->interp) != TCL_OK)
+	  AP_LOG_RERROR(r, "mod_websh - error writing the response: %s", Tcl_GetStringResult(webInterp->interp));
 
+      /* flushes the output of the script */
       if (destroyApchannel(webInterp->interp) != TCL_OK) {
           expireWebInterp(webInterp);  // XXX: mark this interp as expired
 
@@ -298,10 +534,38 @@ static int websh_run_script(request_rec * r)
 	  status = HTTP_INTERNAL_SERVER_ERROR;
       }
 
+      /* the client does not wait for onexit, web::defer and the cleanup */
+      if (status == OK && finish_response(r) != APR_SUCCESS)
+	  AP_LOG_RERROR(r, "mod_websh - error finishing the response");
+      webInterp->timing[WIP_PHASE_SENT] = (long) apr_time_now();
+
+      /* output of onexit and web::defer is logged, not lost silently */
+      if (createFinishedApchannel(webInterp->interp, r) != TCL_OK)
+	  AP_LOG_RERROR(r, "mod_websh - cannot create finished apchannel");
+
+      if (webResetRequest(webInterp->interp, WEB_RESET_CLEANUP) != TCL_OK) {
+          expireWebInterp(webInterp);  // XXX: mark this interp as expired
+	  AP_LOG_RERROR(r, "mod_websh - error while cleaning-up: %s", Tcl_GetStringResult(webInterp->interp));
+	  /* too late if the response is complete already */
+	  if (status != OK)
+	      status = HTTP_INTERNAL_SERVER_ERROR;
+      }
+      destroyApchannel(webInterp->interp);
+      webInterp->timing[WIP_PHASE_CLEANUP] = (long) apr_time_now();
+      //-------------------------------------------------------//
+
     } while(0); 
 
+    /* webInterp may be gone after the release */
+    memcpy(timing, webInterp->timing, sizeof(timing));
+
     apr_pool_cleanup_run(r->pool, webInterp, release_webinterp);
 
+    /* for LogFormat %{websh-timing}n */
+    timing[WIP_PHASE_RELEASE] = (long) apr_time_now();
+    apr_table_setn(r->notes, WEB_TIMING_NOTE,
+		   webInterpTimingString(r->pool, timing, timing[WIP_PHASE_RELEASE], 0));
+
     return status;
 }
 
@@ -345,6 +609,45 @@ static int websh_handler(request_rec * r)
     return status;			/* NOT r->status, even if it has changed. */
 }
 
+#ifdef APACHE2
+/* ----------------------------------------------------------------------------
+ * websh_pre_connection -- prestarts the pool of the worker thread. Apache
+ * has no hook for the start of a worker thread, so the first connection of
+ * each worker waits for this.
+ * ------------------------------------------------------------------------- */
+static int websh_pre_connection(conn_rec * c, void *csd)
+{
+    websh_server_conf *conf =
+	(websh_server_conf *) ap_get_module_config(c->base_server->module_config,
+						   &websh_module);
+
+    poolPrestartThread(conf, c->current_thread);
+
+    return OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * websh_log_transaction -- runs after the response has been sent
+ * ------------------------------------------------------------------------- */
+static int websh_log_transaction(request_rec * r)
+{
+    websh_server_conf *conf;
+
+    if (!r->handler || strcmp(r->handler, WEBSH_HANDLER))
+	return DECLINED;
+
+    conf = (websh_server_conf *) ap_get_module_config(r->server->module_config,
+						      &websh_module);
+
+    /* destroy expired interps and refill spare ones: this client
+       has its response, but the next request of this worker waits */
+    poolReapThread(conf);
+    poolRefillThreadWebInterp(conf);
+
+    return DECLINED;
+}
+#endif /* APACHE2 */
+
 static int websh_post_config(apr_pool_t *pconf, apr_pool_t *ptemp,
                           apr_pool_t *plog, server_rec *s)
 {
@@ -395,6 +698,10 @@ static void register_websh_hooks(apr_pool_t *p)
 
     ap_hook_child_init(websh_init_child, NULL, NULL, APR_HOOK_MIDDLE);
 
+    ap_hook_pre_connection(websh_pre_connection, NULL, NULL, APR_HOOK_MIDDLE);
+
+    ap_hook_log_transaction(websh_log_transaction, NULL, NULL, APR_HOOK_MIDDLE);
+
     ap_hook_post_config(websh_post_config, NULL, NULL, APR_HOOK_MIDDLE);
 }
 
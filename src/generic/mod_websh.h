@@ -49,6 +49,14 @@
 #define WEB_AP_ASSOC_DATA "web::ap"
 #define WEB_INTERP_ASSOC_DATA "web::interp"
 
+/* WebshInterpMap: requested files matching pattern use class classid */
+typedef struct
+{
+    const char *pattern;
+    const char *classid;
+}
+websh_interpmap_rule;
+
 typedef struct
 {
     const char *scriptName;
@@ -56,11 +64,23 @@ typedef struct
     Tcl_Mutex mainInterpLock;
     Tcl_HashTable *webshPool;
     Tcl_Mutex webshPoolLock;
+    apr_array_header_t *prestartClasses;	/* WebshPrestart */
+    long reaperInterval;	/* WebshReaperInterval (seconds) */
+    long reaperMaxTime;		/* WebshReaperMaxTime (milliseconds) */
+    int reaperTrim;		/* WebshReaperTrim */
+    int watchFiles;		/* WebshWatchFiles */
+    int serverTiming;		/* WebshServerTiming */
+    int limitStatus;		/* WebshLimitStatus */
+    long maxInterps;		/* WebshMaxInterps */
+    apr_array_header_t *interpMapRules;	/* WebshInterpMap */
+    Tcl_HashTable *classDefaults;	/* web::interpclasscfg of WebshConfig */
+    int customInterpMap;	/* WebshConfig defines web::interpmap */
     server_rec *server;
 }
 websh_server_conf;
 
 int createApchannel(Tcl_Interp * interp, request_rec * r);
 int destroyApchannel(Tcl_Interp * interp);
+int createFinishedApchannel(Tcl_Interp * interp, request_rec * r);
 
 #endif
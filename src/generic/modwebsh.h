@@ -39,6 +39,9 @@ int __declspec(dllexport) Web_InterpCfg(ClientData clientData,
 int __declspec(dllexport) Web_InterpClassCfg(ClientData clientData,
 		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
 
+int __declspec(dllexport) Web_InterpStats(ClientData clientData,
+		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+
 /* declarations for local (mod_websh) implementation */
 
 int Web_Initializer_AP(ClientData clientData,
@@ -59,6 +62,9 @@ int Web_InterpCfg_AP(ClientData clientData,
 int Web_InterpClassCfg_AP(ClientData clientData,
 		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
 
+int Web_InterpStats_AP(ClientData clientData,
+		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+
 ResponseObj* createDefaultResponseObj_AP(Tcl_Interp * interp);
 
 int isDefaultResponseObj_AP(Tcl_Interp * interp, char *name);
@@ -67,6 +73,8 @@ Tcl_Obj* requestGetDefaultChannelName_AP(Tcl_Interp * interp);
 
 char* requestGetDefaultOutChannelName_AP(Tcl_Interp * interp);
 
+Tcl_Obj* requestGetTiming_AP(Tcl_Interp * interp);
+
 int requestFillRequestValues_AP(Tcl_Interp *interp, RequestData *requestData);
 
 int Web_ConfigPath_AP(Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
@@ -18,6 +18,7 @@
 #include "mod_websh.h"
 #include "modwebsh.h"
 #include "interpool.h"
+#include "mainthread.h"
 
 /* -------------------------------------------------------------------------
  * Web_Initializer -- if request counter is 0, eval the code
@@ -60,6 +61,9 @@ int Web_Initializer_AP(ClientData clientData,
 
 	if (res != TCL_OK) {
 
+	    /* a new version of the code is not taken (see interpool.c) */
+	    webInterp->initFailed = 1;
+
 	    LOG_MSG(interp, WRITE_LOG | INTERP_ERRORINFO,
 		    __FILE__, __LINE__,
 		    "web::initializer", WEBLOG_ERROR,
@@ -199,7 +203,8 @@ int Web_InterpCfg_AP(ClientData clientData,
 	"lastusedtime",
 	"time_request",
 	"time_ready",
-	"retire"
+	"retire",
+	NULL
     };
     enum params {
       INTERP_REQUESTS, INTERP_START, INTERP_LASTUSED,
@@ -282,7 +287,7 @@ int Web_InterpCfg_AP(ClientData clientData,
 		    return TCL_ERROR;
 		}
 		if (retire)
-		    webInterp->state = WIP_EXPIRED_INUSE;
+		    expireWebInterpFor(webInterp, WIP_EXPIRY_RETIRE);
 		else
 		    webInterp->state = WIP_INUSE;
 	    }
@@ -307,17 +312,35 @@ int Web_InterpClassCfg_AP(ClientData clientData,
     int index;
 
     static TCLCONST char *classParams[] = { "maxttl", 
-					    "maxidletime", "maxrequests" };
+					    "maxidletime", "maxrequests",
+					    "prestart", "minspare",
+					    "maxexectime", "maxcommands",
+					    "maxmemory", "maxinterps",
+					    "maxconcurrent", "maxcreaterate",
+					    "maxqueue", "queuetimeout", NULL };
     enum params
-    { CLASS_TTL, CLASS_IDLETIME, CLASS_REQUESTS };
-
-    // websh_server_conf *conf = (websh_server_conf *) clientData;
-    // Tcl_HashTable *webshPool = conf->webshPool;
-
-    WebInterp *webInterp = (WebInterp *) clientData;
-    webInterpClass = webInterp->interpClass;
-    websh_server_conf *conf = webInterpClass->conf;
-    Tcl_HashTable *webshPool = webInterpClass->webshPool;
+    { CLASS_TTL, CLASS_IDLETIME, CLASS_REQUESTS,
+      CLASS_PRESTART, CLASS_MINSPARE,
+      CLASS_EXECTIME, CLASS_COMMANDS, CLASS_MEMORY, CLASS_INTERPS,
+      CLASS_CONCURRENT, CLASS_CREATERATE, CLASS_QUEUE, CLASS_QUEUETIMEOUT };
+    /* admission limits, same order as above */
+    static AdmissionLimit admissionLimits[] = {
+	ADMISSION_MAXCONCURRENT, ADMISSION_MAXCREATERATE,
+	ADMISSION_MAXQUEUE, ADMISSION_QUEUETIMEOUT };
+
+    websh_server_conf *conf = NULL;
+    Tcl_HashTable *webshPool = NULL;
+
+    webshPool = (Tcl_HashTable *) Tcl_GetAssocData(interp, WEB_POOL_ASSOC_DATA, NULL);
+    if (webshPool != NULL) {
+	/* main interp: clientData is the server config */
+	conf = (websh_server_conf *) clientData;
+    } else {
+	/* pool interp: clientData is the WebInterp */
+	WebInterp *webInterp = (WebInterp *) clientData;
+	conf = webInterp->interpClass->conf;
+	webshPool = webInterp->interpClass->webshPool;
+    }
 
     WebAssertObjc(objc < 3 || objc > 4, 1, "id parameter ?value?");
 
@@ -328,7 +351,9 @@ int Web_InterpClassCfg_AP(ClientData clientData,
     webInterpClass = poolCreateWebInterpClass(conf, webshPool, id, 0);
 
     if(webInterpClass == NULL){
-      // TODO: return error
+	Tcl_MutexUnlock(&(conf->webshPoolLock));
+	Tcl_SetResult(interp, "cannot create interpreter class", NULL);
+	return TCL_ERROR;
     }
 
 
@@ -374,6 +399,98 @@ int Web_InterpClassCfg_AP(ClientData clientData,
 	    Tcl_SetObjResult(interp, Tcl_NewLongObj(maxrequests));
 	    break;
 	}
+    case CLASS_PRESTART:{
+	    long prestart = webInterpClass->prestart;
+	    if (objc == 4)
+		if (Tcl_GetLongFromObj
+		    (interp, objv[3],
+		     &(webInterpClass->prestart)) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(prestart));
+	    break;
+	}
+    case CLASS_MINSPARE:{
+	    long minspare = webInterpClass->minspare;
+	    if (objc == 4)
+		if (Tcl_GetLongFromObj
+		    (interp, objv[3],
+		     &(webInterpClass->minspare)) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(minspare));
+	    break;
+	}
+    case CLASS_EXECTIME:{
+	    long maxexectime = webInterpClass->maxexectime;
+	    if (objc == 4)
+		if (Tcl_GetLongFromObj
+		    (interp, objv[3],
+		     &(webInterpClass->maxexectime)) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(maxexectime));
+	    break;
+	}
+    case CLASS_COMMANDS:{
+	    long maxcommands = webInterpClass->maxcommands;
+	    if (objc == 4)
+		if (Tcl_GetLongFromObj
+		    (interp, objv[3],
+		     &(webInterpClass->maxcommands)) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(maxcommands));
+	    break;
+	}
+    case CLASS_MEMORY:{
+	    long maxmemory = webInterpClass->maxmemory;
+	    if (objc == 4)
+		if (Tcl_GetLongFromObj
+		    (interp, objv[3],
+		     &(webInterpClass->maxmemory)) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(maxmemory));
+	    break;
+	}
+    case CLASS_INTERPS:{
+	    /* process-wide, shared by the classes of all threads */
+	    long maxinterps = webInterpClass->budgetClass->max;
+	    if (objc == 4) {
+		long value;
+		if (Tcl_GetLongFromObj(interp, objv[3], &value) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+		budgetSetClassMax(webInterpClass->budgetClass, value);
+	    }
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(maxinterps));
+	    break;
+	}
+    case CLASS_CONCURRENT:
+    case CLASS_CREATERATE:
+    case CLASS_QUEUE:
+    case CLASS_QUEUETIMEOUT:{
+	    /* process-wide, shared by the classes of all threads */
+	    AdmissionLimit limit = admissionLimits[index - CLASS_CONCURRENT];
+	    long old = admissionGetLimit(webInterpClass->admission, limit);
+	    if (objc == 4) {
+		long value;
+		if (Tcl_GetLongFromObj(interp, objv[3], &value) != TCL_OK) {
+		    Tcl_MutexUnlock(&(conf->webshPoolLock));
+		    return TCL_ERROR;
+		}
+		admissionSetLimit(webInterpClass->admission, limit, value);
+	    }
+	    Tcl_SetObjResult(interp, Tcl_NewLongObj(old));
+	    break;
+	}
     }
 
     Tcl_MutexUnlock(&(conf->webshPoolLock));
@@ -382,6 +499,74 @@ int Web_InterpClassCfg_AP(ClientData clientData,
 }
 
 
+/* ----------------------------------------------------------------------------
+ * Web_InterpStats -- counters of the WebInterpClasses of this pool
+ * ------------------------------------------------------------------------- */
+int Web_InterpStats_AP(ClientData clientData,
+		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+    WebInterpClass *webInterpClass = NULL;
+    Tcl_Obj *result = NULL;
+    int withInterps = 0;
+    int first = 1;
+
+    websh_server_conf *conf = NULL;
+    Tcl_HashTable *webshPool = NULL;
+
+    webshPool = (Tcl_HashTable *) Tcl_GetAssocData(interp, WEB_POOL_ASSOC_DATA, NULL);
+    if (webshPool != NULL) {
+	/* main interp: clientData is the server config */
+	conf = (websh_server_conf *) clientData;
+    } else {
+	/* pool interp: clientData is the WebInterp */
+	WebInterp *webInterp = (WebInterp *) clientData;
+	conf = webInterp->interpClass->conf;
+	webshPool = webInterp->interpClass->webshPool;
+    }
+
+    if (objc > 1 && !strcmp(Tcl_GetString(objv[1]), "-interps")) {
+	withInterps = 1;
+	first = 2;
+    }
+
+    WebAssertObjc(objc > first + 1, 1, "?-interps? ?id?");
+
+    Tcl_MutexLock(&(conf->webshPoolLock));
+
+    if (objc == first + 1) {
+	entry = Tcl_FindHashEntry(webshPool, Tcl_GetString(objv[first]));
+	if (entry == NULL) {
+	    Tcl_MutexUnlock(&(conf->webshPoolLock));
+	    Tcl_AppendResult(interp, "no interpreter class \"",
+			     Tcl_GetString(objv[first]), "\"", NULL);
+	    return TCL_ERROR;
+	}
+	webInterpClass = (WebInterpClass *) Tcl_GetHashValue(entry);
+	result = poolWebInterpClassStats(webInterpClass, withInterps);
+    } else {
+	/* id -> stats of every class */
+	result = Tcl_NewObj();
+	entry = Tcl_FirstHashEntry(webshPool, &search);
+	while (entry != NULL) {
+	    webInterpClass = (WebInterpClass *) Tcl_GetHashValue(entry);
+	    Tcl_ListObjAppendElement(NULL, result,
+				     Tcl_NewStringObj(webInterpClass->filename, -1));
+	    Tcl_ListObjAppendElement(NULL, result,
+				     poolWebInterpClassStats(webInterpClass, withInterps));
+	    entry = Tcl_NextHashEntry(&search);
+	}
+    }
+
+    Tcl_MutexUnlock(&(conf->webshPoolLock));
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+
 /* ----------------------------------------------------------------------------
  * Web_MainEval -- eval in main interp
  * ------------------------------------------------------------------------- */
@@ -391,9 +576,24 @@ int Web_MainEval_AP(ClientData clientData,
 
     int res = 0;
     websh_server_conf *conf;
+    Tcl_Obj *command = NULL;
+    int async = 0;
+
+    /* the published snapshot needs neither the main interp nor a lock */
+    if (objc == 3 && !strcmp(Tcl_GetString(objv[1]), "-readonly"))
+	return mainSnapshotGet(interp, Tcl_GetString(objv[2]));
+
+    if (objc >= 3 && !strcmp(Tcl_GetString(objv[1]), "-async")) {
+	async = 1;
+	if (objc == 5 && !strcmp(Tcl_GetString(objv[2]), "-command"))
+	    command = objv[3];
+	else if (objc != 3)
+	    async = -1;
+    }
 
-    if (objc != 2) {
-	Tcl_WrongNumArgs(interp, 1, objv, "code");
+    if ((!async && objc != 2) || async < 0) {
+	Tcl_WrongNumArgs(interp, 1, objv,
+			 "?-async ?-command command?? code | -readonly varName");
 	return TCL_ERROR;
     }
 
@@ -415,6 +615,9 @@ int Web_MainEval_AP(ClientData clientData,
 	return TCL_ERROR;
     }
 
+    if (async)
+	return mainThreadEvalAsync(conf, interp, objv[objc - 1], command);
+
     Tcl_MutexLock(&(conf->mainInterpLock));
 
     Tcl_IncrRefCount(objv[1]);
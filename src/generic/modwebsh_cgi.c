@@ -103,6 +103,19 @@ int __declspec(dllexport) Web_InterpClassCfg(ClientData clientData,
     return TCL_OK;
 }
 
+/* ----------------------------------------------------------------------------
+ * Web_InterpStats -- just return
+ * ------------------------------------------------------------------------- */
+int __declspec(dllexport) Web_InterpStats(ClientData clientData,
+		       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+    ApFuncs *apFuncs = Tcl_GetAssocData(interp, WEB_APFUNCS_ASSOC_DATA, NULL);
+    if (apFuncs != NULL)
+      return apFuncs->Web_InterpStats(clientData, interp, objc, objv);
+
+    return TCL_OK;
+}
+
 /* ----------------------------------------------------------------------------
  * Web_InterpCfg -- just return
  * ------------------------------------------------------------------------- */
@@ -223,5 +236,8 @@ int modwebsh_createcmd(Tcl_Interp * interp)
     Tcl_CreateObjCommand(interp, "web::interpclasscfg",
 			 Web_InterpClassCfg, NULL, NULL);
 
+    Tcl_CreateObjCommand(interp, "web::interpstats",
+			 Web_InterpStats, NULL, NULL);
+
     return TCL_OK;
 }
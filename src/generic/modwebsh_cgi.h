@@ -33,6 +33,8 @@ typedef struct
   int (*Web_MainEval) (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
   int (*Web_ConfigPath) (Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
   int (*ModWebsh_Init) (Tcl_Interp *interp);
+  int (*Web_InterpStats) (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
+  Tcl_Obj* (*requestGetTiming) (Tcl_Interp * interp);
 }
 ApFuncs;
 
@@ -0,0 +1,715 @@
+/*
+ * putxtmpl.c -- compiled web::putx templates
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "webutl.h"
+#include "hashutl.h"
+#include "srccache.h"
+#include "putxtmpl.h"
+
+#define PUTX_SUBST_IGNORE    0          /* <? set abc 123 ?> */
+#define PUTX_SUBST_RESULT    1          /* <?= set abc 123 ?> */
+#define PUTX_SUBST_VARIABLE  2          /* <?= $abc ?> */
+
+typedef struct PutxBuilder
+{
+    PutxTemplate *tmpl;
+    int size;			/* of tmpl->segments */
+    int complete;		/* all code sections are complete commands */
+}
+PutxBuilder;
+
+/* ----------------------------------------------------------------------------
+ * addSegment
+ * ------------------------------------------------------------------------- */
+static void addSegment(PutxBuilder * builder, PutxSegmentType type,
+		       Tcl_Obj * text, Tcl_Obj * name)
+{
+    PutxTemplate *tmpl = builder->tmpl;
+    PutxSegment *segment;
+
+    if (tmpl->numSegments == builder->size) {
+	builder->size = (builder->size > 0) ? 2 * builder->size : 8;
+	if (tmpl->segments == NULL)
+	    tmpl->segments = (PutxSegment *)
+		Tcl_Alloc(builder->size * sizeof(PutxSegment));
+	else
+	    tmpl->segments = (PutxSegment *)
+		Tcl_Realloc((char *) tmpl->segments,
+			    builder->size * sizeof(PutxSegment));
+    }
+    segment = &(tmpl->segments[tmpl->numSegments++]);
+    segment->type = type;
+    segment->text = text;
+    Tcl_IncrRefCount(text);
+    segment->name = name;
+    WebIncrRefCountIfNotNull(name);
+}
+
+/* ----------------------------------------------------------------------------
+ * addCode -- code must be a complete command to be a segment of its own
+ * ------------------------------------------------------------------------- */
+static void addCode(PutxBuilder * builder, PutxSegmentType type,
+		    Tcl_Obj * code)
+{
+    Tcl_DString check;
+
+    Tcl_DStringInit(&check);
+    Tcl_DStringAppend(&check, Tcl_GetString(code), -1);
+    Tcl_DStringAppend(&check, "\n", 1);
+    if (!Tcl_CommandComplete(Tcl_DStringValue(&check)))
+	builder->complete = 0;
+    Tcl_DStringFree(&check);
+
+    addSegment(builder, type, code, NULL);
+}
+
+/* ----------------------------------------------------------------------------
+ * isVarRef -- is start a single variable reference like $abc or $a($i) ?
+ * If no substitution is needed to get the name, *name is set to it.
+ * ------------------------------------------------------------------------- */
+static int isVarRef(TCLCONST char *start, int len, Tcl_Obj ** name)
+{
+    Tcl_Parse parse;
+    int i, res = 0;
+
+    if (name != NULL)
+	*name = NULL;
+    if (len < 2 || start[0] != '$')
+	return 0;
+    if (Tcl_ParseVarName(NULL, start, len, &parse, 0) != TCL_OK)
+	return 0;
+
+    if (parse.numTokens > 1
+	&& parse.tokenPtr[0].type == TCL_TOKEN_VARIABLE
+	&& parse.tokenPtr[0].size == len) {
+	res = 1;
+	for (i = 1; i < parse.numTokens; i++) {
+	    if (parse.tokenPtr[i].type != TCL_TOKEN_TEXT)
+		break;
+	}
+	/* ${a(b)} is a scalar, Tcl_ObjGetVar2 would take it as element */
+	if (name != NULL && i == parse.numTokens && start[1] != '{')
+	    *name = Tcl_NewStringObj(start + 1, len - 1);
+    }
+    Tcl_FreeParse(&parse);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * braceVarLength -- length of {{$var}} at p, 0 if there is none.
+ * *start and *len are set to the variable reference.
+ * ------------------------------------------------------------------------- */
+static int braceVarLength(TCLCONST char *p, TCLCONST char **start, int *len)
+{
+    TCLCONST char *ref;
+    TCLCONST char *end;
+    TCLCONST char *close;
+
+    if (p[0] != '{' || p[1] != '{')
+	return 0;
+    ref = p + 2;
+    while (*ref == ' ' || *ref == '\t')
+	ref++;
+    if (*ref != '$')
+	return 0;
+    close = strstr(ref, "}}");
+    if (close == NULL)
+	return 0;
+    end = close;
+    while (end > ref && (end[-1] == ' ' || end[-1] == '\t'))
+	end--;
+    if (!isVarRef(ref, end - ref, NULL))
+	return 0;
+    *start = ref;
+    *len = end - ref;
+    return close + 2 - p;
+}
+
+/* ----------------------------------------------------------------------------
+ * addVariable -- <?= $var ?> or {{$var}}
+ * ------------------------------------------------------------------------- */
+static void addVariable(PutxBuilder * builder, TCLCONST char *start,
+			int len)
+{
+    Tcl_Obj *name = NULL;
+    Tcl_Obj *code;
+
+    if (isVarRef(start, len, &name) && name != NULL) {
+	addSegment(builder, PUTX_VARIABLE, Tcl_NewStringObj(start, len), name);
+	return;
+    }
+    /* anything else is passed to web::put, as it always was */
+    code = Tcl_NewStringObj("web::put ", -1);
+    Tcl_AppendToObj(code, start, len);
+    addCode(builder, PUTX_CODE, code);
+}
+
+/* ----------------------------------------------------------------------------
+ * flushLiteral, flushCode -- end of a section, text is reset
+ * ------------------------------------------------------------------------- */
+static void flushLiteral(PutxBuilder * builder, Tcl_Obj ** text)
+{
+    int len;
+
+    Tcl_GetStringFromObj(*text, &len);
+    /* web::putx never wrote before leading code (headers!) */
+    if (len > 0 || builder->tmpl->numSegments > 0)
+	addSegment(builder, PUTX_LITERAL, *text, NULL);
+    Tcl_DecrRefCount(*text);
+    *text = Tcl_NewObj();
+    Tcl_IncrRefCount(*text);
+}
+
+static void flushCode(PutxBuilder * builder, Tcl_Obj ** text, int subst)
+{
+    TCLCONST char *code;
+    int len;
+
+    switch (subst) {
+    case PUTX_SUBST_RESULT:
+	addCode(builder, PUTX_RESULT, *text);
+	break;
+    case PUTX_SUBST_VARIABLE:
+	code = Tcl_GetStringFromObj(*text, &len);
+	while (len > 0 && strchr(" \t\r\n", code[len - 1]) != NULL)
+	    len--;
+	addVariable(builder, code, len);
+	break;
+    default:
+	addCode(builder, PUTX_CODE, *text);
+	break;
+    }
+    Tcl_DecrRefCount(*text);
+    *text = Tcl_NewObj();
+    Tcl_IncrRefCount(*text);
+}
+
+/* ----------------------------------------------------------------------------
+ * buildScript -- the template as single script
+ * ------------------------------------------------------------------------- */
+static Tcl_Obj *buildScript(PutxTemplate * tmpl)
+{
+    Tcl_Obj *script = Tcl_NewObj();
+    PutxSegment *segment;
+    TCLCONST char *run;
+    TCLCONST char *cur;
+    int i, len;
+
+    for (i = 0; i < tmpl->numSegments; i++) {
+	segment = &(tmpl->segments[i]);
+	switch (segment->type) {
+	case PUTX_LITERAL:
+	    Tcl_AppendToObj(script, "web::put \"", -1);
+	    run = Tcl_GetStringFromObj(segment->text, &len);
+	    for (cur = run; *cur != 0; cur++) {
+		if (strchr("\\{}$[]\"", *cur) != NULL) {
+		    Tcl_AppendToObj(script, run, cur - run);
+		    Tcl_AppendToObj(script, "\\", 1);
+		    run = cur;
+		}
+	    }
+	    Tcl_AppendToObj(script, run, cur - run);
+	    Tcl_AppendToObj(script, "\"\n", 2);
+	    break;
+	case PUTX_CODE:
+	    Tcl_AppendObjToObj(script, segment->text);
+	    Tcl_AppendToObj(script, "\n", 1);
+	    break;
+	case PUTX_RESULT:
+	    Tcl_AppendToObj(script, "web::put [", -1);
+	    Tcl_AppendObjToObj(script, segment->text);
+	    Tcl_AppendToObj(script, "]\n", 2);
+	    break;
+	case PUTX_VARIABLE:
+	    Tcl_AppendToObj(script, "web::put ", -1);
+	    Tcl_AppendObjToObj(script, segment->text);
+	    Tcl_AppendToObj(script, "\n", 1);
+	    break;
+	}
+    }
+    return script;
+}
+
+/* ----------------------------------------------------------------------------
+ * freeSegments
+ * ------------------------------------------------------------------------- */
+static void freeSegments(PutxTemplate * tmpl)
+{
+    int i;
+
+    for (i = 0; i < tmpl->numSegments; i++) {
+	Tcl_DecrRefCount(tmpl->segments[i].text);
+	WebDecrRefCountIfNotNull(tmpl->segments[i].name);
+    }
+    WebFreeIfNotNull(tmpl->segments);
+    tmpl->segments = NULL;
+    tmpl->numSegments = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * putxCompile -- compile template in (code in strstart ... strend).
+ * {{$var}} is only taken as variable if braceVars is set (web::config
+ * putxvars), it is common literal text in client-side templates.
+ * The template is returned with a reference count of 1.
+ * ------------------------------------------------------------------------- */
+PutxTemplate *putxCompile(Tcl_Obj * in, TCLCONST char *strstart,
+			  TCLCONST char *strend, int braceVars)
+{
+    PutxBuilder builder;
+    Tcl_Obj *text;
+    TCLCONST char *next;
+    TCLCONST char *cur;
+    TCLCONST char *run;
+    TCLCONST char *start;
+    int startlen = strlen(strstart);
+    int endlen = strlen(strend);
+    int inside = 0;
+    int subst = PUTX_SUBST_IGNORE;
+    int len = 0;
+    int n = 0;
+
+    builder.tmpl = WebAllocInternalData(PutxTemplate);
+    if (builder.tmpl == NULL)
+	return NULL;
+    memset(builder.tmpl, 0, sizeof(PutxTemplate));
+    builder.tmpl->refCount = 1;
+    builder.size = 0;
+    builder.complete = 1;
+
+    /* with brace markup, { starts code */
+    if (*strstart == '{')
+	braceVars = 0;
+
+    run = next = Tcl_GetString(in);
+    text = Tcl_NewObj();
+    Tcl_IncrRefCount(text);
+
+    while (*next != 0) {
+	cur = next;
+	next = cur + 1;
+
+	/* plain text is appended in runs (markup is ASCII only) */
+	if (*cur != '\\' && (*cur != '{' || !braceVars) && *cur != *strstart
+	    && *cur != *strend)
+	    continue;
+	Tcl_AppendToObj(text, run, cur - run);
+
+	if (*cur == '\\') {
+	    if (strncmp(strstart, next, startlen) == 0) {
+		/* escaped tags: the backslash stays in code */
+		if (inside > 0)
+		    Tcl_AppendToObj(text, "\\", 1);
+		Tcl_AppendToObj(text, strstart, startlen);
+		next += startlen;
+	    }
+	    else if (strncmp(strend, next, endlen) == 0) {
+		if (inside > 0)
+		    Tcl_AppendToObj(text, "\\", 1);
+		Tcl_AppendToObj(text, strend, endlen);
+		next += endlen;
+	    }
+	    else if (braceVars && inside < 1
+		     && (n = braceVarLength(next, &start, &len)) > 0) {
+		/* escaped {{$var}} */
+		Tcl_AppendToObj(text, next, n);
+		next += n;
+	    }
+	    else {
+		Tcl_AppendToObj(text, "\\", 1);
+	    }
+	}
+	else if (braceVars && inside < 1
+		 && (n = braceVarLength(cur, &start, &len)) > 0) {
+	    flushLiteral(&builder, &text);
+	    addVariable(&builder, start, len);
+	    next = cur + n;
+	}
+	else if (strncmp(strstart, cur, startlen) == 0) {
+	    next = cur + startlen;
+	    if ((++inside) == 1) {
+		flushLiteral(&builder, &text);
+		subst = PUTX_SUBST_IGNORE;
+		if (*next == '=') {
+		    subst = PUTX_SUBST_RESULT;
+		    next++;
+		    while (*next == ' ' || *next == '\t')
+			next++;
+		    if (*next == '$')
+			subst = PUTX_SUBST_VARIABLE;
+		}
+	    }
+	    else {
+		Tcl_AppendToObj(text, cur, startlen);
+	    }
+	}
+	else if (strncmp(strend, cur, endlen) == 0) {
+	    next = cur + endlen;
+	    if ((--inside) == 0)
+		flushCode(&builder, &text, subst);
+	    else
+		Tcl_AppendToObj(text, cur, endlen);
+	    if (inside < 0)
+		inside = 0;
+	}
+	else {
+	    /* no markup after all */
+	    Tcl_AppendToObj(text, cur, 1);
+	}
+	run = next;
+    }
+    Tcl_AppendToObj(text, run, next - run);
+
+    if (inside > 0)
+	flushCode(&builder, &text, subst);
+    else
+	flushLiteral(&builder, &text);
+    Tcl_DecrRefCount(text);
+
+    if (!builder.complete) {
+	builder.tmpl->script = buildScript(builder.tmpl);
+	Tcl_IncrRefCount(builder.tmpl->script);
+	freeSegments(builder.tmpl);
+    }
+
+    return builder.tmpl;
+}
+
+/* ----------------------------------------------------------------------------
+ * putxSelected -- the selected response object. Code of the template might
+ * select another one, web::put writes to that one too.
+ * ------------------------------------------------------------------------- */
+static ResponseObj *putxSelected(OutData * outData, ResponseObj * responseObj)
+{
+    if (outData != NULL)
+	return outData->defaultResponseObj;
+    return responseObj;
+}
+
+/* ----------------------------------------------------------------------------
+ * putxWrite -- write to the selected response object
+ * ------------------------------------------------------------------------- */
+static int putxWrite(Tcl_Interp * interp, OutData * outData,
+		     ResponseObj * responseObj, Tcl_Obj * value)
+{
+    int res;
+
+    Tcl_IncrRefCount(value);
+    res = putsCmdImpl(interp, putxSelected(outData, responseObj), value);
+    Tcl_DecrRefCount(value);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * putxEval -- eval template. flags are passed to Tcl_EvalObjEx.
+ * ------------------------------------------------------------------------- */
+int putxEval(Tcl_Interp * interp, OutData * outData,
+	     ResponseObj * responseObj, PutxTemplate * tmpl, int flags)
+{
+    PutxSegment *segment;
+    Tcl_Obj *value;
+    int i;
+    int res = TCL_OK;
+
+    if (tmpl->script != NULL)
+	return Tcl_EvalObjEx(interp, tmpl->script, flags);
+
+    /* code of the template might drop it from the cache */
+    tmpl->refCount++;
+
+    for (i = 0; i < tmpl->numSegments && res == TCL_OK; i++) {
+	segment = &(tmpl->segments[i]);
+	switch (segment->type) {
+	case PUTX_LITERAL:
+	    /* even an empty one, it sends the headers */
+	    res = putxWrite(interp, outData, responseObj, segment->text);
+	    break;
+	case PUTX_CODE:
+	    res = Tcl_EvalObjEx(interp, segment->text, flags);
+	    break;
+	case PUTX_RESULT:
+	    res = Tcl_EvalObjEx(interp, segment->text, flags);
+	    if (res == TCL_OK)
+		res = putxWrite(interp, outData, responseObj,
+				Tcl_GetObjResult(interp));
+	    break;
+	case PUTX_VARIABLE:
+	    value = Tcl_ObjGetVar2(interp, segment->name, NULL,
+				   TCL_LEAVE_ERR_MSG);
+	    if (value == NULL)
+		res = TCL_ERROR;
+	    else
+		res = putxWrite(interp, outData, responseObj, value);
+	    break;
+	}
+    }
+    if (res == TCL_OK)
+	Tcl_ResetResult(interp);
+
+    putxRelease(tmpl);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * putxRelease -- drop a reference to tmpl
+ * ------------------------------------------------------------------------- */
+void putxRelease(PutxTemplate * tmpl)
+{
+    if (--tmpl->refCount > 0)
+	return;
+    freeSegments(tmpl);
+    WebDecrRefCountIfNotNull(tmpl->script);
+    Tcl_Free((char *) tmpl);
+}
+
+/* ----------------------------------------------------------------------------
+ * putx cache -- maps template content to its compiled form, one table per
+ * markup. Code is evaluated directly when a template is seen the first
+ * time, and compiled to bytecode when it is seen again, so one-off
+ * strings (e.g. with substituted variables) cost no more than before.
+ * At most putxCacheSize templates are kept per markup, the least recently
+ * used is dropped first.
+ * ------------------------------------------------------------------------- */
+static void deletePutxTemplate(Tcl_HashEntry * entry)
+{
+    putxRelease((PutxTemplate *) Tcl_GetHashValue(entry));
+    Tcl_DeleteHashEntry(entry);
+}
+
+static void evictPutxTemplate(Tcl_HashTable * cache)
+{
+    Tcl_HashEntry *entry;
+    Tcl_HashEntry *oldest = NULL;
+    Tcl_HashSearch search;
+    PutxTemplate *tmpl;
+    long lastUsed = 0;
+
+    for (entry = Tcl_FirstHashEntry(cache, &search); entry != NULL;
+	 entry = Tcl_NextHashEntry(&search)) {
+	tmpl = (PutxTemplate *) Tcl_GetHashValue(entry);
+	if (oldest == NULL || tmpl->lastUsed < lastUsed) {
+	    oldest = entry;
+	    lastUsed = tmpl->lastUsed;
+	}
+    }
+    if (oldest != NULL)
+	deletePutxTemplate(oldest);
+}
+
+/* ----------------------------------------------------------------------------
+ * webout_eval_cached -- like webout_eval_tag, using the putx cache
+ * ------------------------------------------------------------------------- */
+int webout_eval_cached(Tcl_Interp * interp, OutData * outData,
+		       ResponseObj * responseObj, Tcl_Obj * in,
+		       TCLCONST char *strstart, TCLCONST char *strend)
+{
+    Tcl_HashTable *cache;
+    Tcl_HashEntry *entry;
+    PutxTemplate *tmpl;
+    int isNew = 0;
+    int flags = 0;
+
+    if (outData->putxCacheSize <= 0)
+	return webout_eval_tag(interp, responseObj, in, strstart, strend);
+
+    cache = outData->putxCache[outData->putxMarkup];
+    if (cache == NULL) {
+	cache = WebAllocInternalData(Tcl_HashTable);
+	if (cache == NULL)
+	    return webout_eval_tag(interp, responseObj, in, strstart, strend);
+	Tcl_InitObjHashTable(cache);
+	outData->putxCache[outData->putxMarkup] = cache;
+    }
+
+    entry = Tcl_FindHashEntry(cache, (char *) in);
+    if (entry == NULL) {
+	tmpl = putxCompile(in, strstart, strend, outData->putxVars);
+	if (tmpl == NULL)
+	    return TCL_ERROR;
+	while (cache->numEntries >= outData->putxCacheSize)
+	    evictPutxTemplate(cache);
+	entry = Tcl_CreateHashEntry(cache, (char *) in, &isNew);
+	Tcl_SetHashValue(entry, (ClientData) tmpl);
+	/* first time: don't compile what might never be seen again */
+	flags = TCL_EVAL_DIRECT;
+    }
+    else {
+	tmpl = (PutxTemplate *) Tcl_GetHashValue(entry);
+    }
+    tmpl->lastUsed = ++outData->putxCacheTick;
+
+    return putxEval(interp, outData, responseObj, tmpl, flags);
+}
+
+/* ----------------------------------------------------------------------------
+ * putx file cache -- maps file names to their templates, at most
+ * putxCacheSize files are kept, the least recently used is dropped first.
+ * ------------------------------------------------------------------------- */
+static void deletePutxFile(Tcl_HashEntry * entry)
+{
+    PutxFile *file = (PutxFile *) Tcl_GetHashValue(entry);
+    int i;
+
+    for (i = 0; i < PUTXMARKUPS; i++)
+	if (file->tmpl[i] != NULL)
+	    putxRelease(file->tmpl[i]);
+    Tcl_Free((char *) file);
+    Tcl_DeleteHashEntry(entry);
+}
+
+static void evictPutxFile(Tcl_HashTable * files)
+{
+    Tcl_HashEntry *entry;
+    Tcl_HashEntry *oldest = NULL;
+    Tcl_HashSearch search;
+    PutxFile *file;
+    long lastUsed = 0;
+
+    for (entry = Tcl_FirstHashEntry(files, &search); entry != NULL;
+	 entry = Tcl_NextHashEntry(&search)) {
+	file = (PutxFile *) Tcl_GetHashValue(entry);
+	if (oldest == NULL || file->lastUsed < lastUsed) {
+	    oldest = entry;
+	    lastUsed = file->lastUsed;
+	}
+    }
+    if (oldest != NULL)
+	deletePutxFile(oldest);
+}
+
+/* ----------------------------------------------------------------------------
+ * webout_eval_file -- eval the template in filename. The file is read
+ * through the source cache and compiled when it has changed (mtime and
+ * size), which is checked at most every putxFileCheck seconds.
+ * ------------------------------------------------------------------------- */
+int webout_eval_file(Tcl_Interp * interp, OutData * outData,
+		     ResponseObj * responseObj, char *filename,
+		     TCLCONST char *strstart, TCLCONST char *strend)
+{
+    Tcl_HashEntry *entry;
+    PutxFile *file;
+    PutxTemplate *tmpl;
+    Tcl_Obj *content;
+    struct stat statBuf;
+    long now = (long) time(NULL);
+    int isNew = 0;
+    int i, res;
+
+    if (outData->putxCacheSize <= 0) {
+	content = sourceCacheGetObj(interp, filename, NULL);
+	if (content == NULL)
+	    return TCL_ERROR;
+	Tcl_IncrRefCount(content);
+	res = webout_eval_tag(interp, responseObj, content, strstart, strend);
+	Tcl_DecrRefCount(content);
+	return res;
+    }
+
+    if (outData->putxFiles == NULL) {
+	HashUtlAllocInit(outData->putxFiles, TCL_STRING_KEYS);
+	if (outData->putxFiles == NULL)
+	    return TCL_ERROR;
+    }
+
+    entry = Tcl_FindHashEntry(outData->putxFiles, filename);
+    if (entry == NULL) {
+	while (outData->putxFiles->numEntries >= outData->putxCacheSize)
+	    evictPutxFile(outData->putxFiles);
+	file = WebAllocInternalData(PutxFile);
+	if (file == NULL)
+	    return TCL_ERROR;
+	memset(file, 0, sizeof(PutxFile));
+	entry = Tcl_CreateHashEntry(outData->putxFiles, filename, &isNew);
+	Tcl_SetHashValue(entry, (ClientData) file);
+    }
+    else {
+	file = (PutxFile *) Tcl_GetHashValue(entry);
+    }
+
+    if (isNew || now - file->checked >= outData->putxFileCheck
+	|| now < file->checked) {
+	if (Tcl_Stat(filename, &statBuf) != 0) {
+	    Tcl_ResetResult(interp);
+	    Tcl_AppendResult(interp, "couldn't read file \"", filename,
+			     "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()),
+			     (char *) NULL);
+	    deletePutxFile(entry);
+	    return TCL_ERROR;
+	}
+	if (file->mtime != (long) statBuf.st_mtime
+	    || file->size != (long) statBuf.st_size) {
+	    for (i = 0; i < PUTXMARKUPS; i++) {
+		if (file->tmpl[i] != NULL)
+		    putxRelease(file->tmpl[i]);
+		file->tmpl[i] = NULL;
+	    }
+	    file->mtime = (long) statBuf.st_mtime;
+	    file->size = (long) statBuf.st_size;
+	}
+	file->checked = now;
+    }
+
+    tmpl = file->tmpl[outData->putxMarkup];
+    if (tmpl == NULL) {
+	content = sourceCacheGetObj(interp, filename, NULL);
+	if (content == NULL) {
+	    deletePutxFile(entry);
+	    return TCL_ERROR;
+	}
+	Tcl_IncrRefCount(content);
+	tmpl = putxCompile(content, strstart, strend, outData->putxVars);
+	Tcl_DecrRefCount(content);
+	if (tmpl == NULL) {
+	    deletePutxFile(entry);
+	    return TCL_ERROR;
+	}
+	file->tmpl[outData->putxMarkup] = tmpl;
+    }
+    file->lastUsed = ++outData->putxCacheTick;
+
+    /* files are rendered again and again: compile the code right away */
+    return putxEval(interp, outData, responseObj, tmpl, 0);
+}
+
+/* ----------------------------------------------------------------------------
+ * webout_clear_cache -- drop all cached putx templates
+ * ------------------------------------------------------------------------- */
+void webout_clear_cache(OutData * outData)
+{
+    Tcl_HashEntry *entry;
+    Tcl_HashSearch search;
+    int i;
+
+    for (i = 0; i < PUTXMARKUPS; i++) {
+	if (outData->putxCache[i] == NULL)
+	    continue;
+	while ((entry = Tcl_FirstHashEntry(outData->putxCache[i], &search))
+	       != NULL)
+	    deletePutxTemplate(entry);
+	HashUtlDelFree(outData->putxCache[i]);
+	outData->putxCache[i] = NULL;
+    }
+    if (outData->putxFiles != NULL) {
+	while ((entry = Tcl_FirstHashEntry(outData->putxFiles, &search))
+	       != NULL)
+	    deletePutxFile(entry);
+	HashUtlDelFree(outData->putxFiles);
+	outData->putxFiles = NULL;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * putxtmpl.h -- compiled web::putx templates
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_PUTXTMPL_H
+#define WEB_PUTXTMPL_H
+
+#include "tcl.h"
+#include "webout.h"
+
+/* ----------------------------------------------------------------------------
+ * A template is compiled to a list of segments:
+ * - literal text, written with one call of putsCmdImpl
+ * - code (<? ... ?>), evaluated
+ * - result (<?= ... ?>), evaluated, the result is written
+ * - variable (<?= $var ?>, or {{$var}} if braceVars), read and written
+ * A template whose code sections are not complete commands on their own,
+ * e.g. <? if {$x} { ?>...<? } ?>, is translated to a single script
+ * instead, as web::putx always did.
+ * ------------------------------------------------------------------------- */
+typedef enum PutxSegmentType
+{
+    PUTX_LITERAL, PUTX_CODE, PUTX_RESULT, PUTX_VARIABLE
+}
+PutxSegmentType;
+
+typedef struct PutxSegment
+{
+    PutxSegmentType type;
+    Tcl_Obj *text;		/* literal, code or variable reference */
+    Tcl_Obj *name;		/* PUTX_VARIABLE: name of the variable */
+}
+PutxSegment;
+
+typedef struct PutxTemplate
+{
+    int refCount;		/* cache and running evaluations */
+    long lastUsed;
+    int numSegments;
+    PutxSegment *segments;
+    Tcl_Obj *script;		/* used instead of segments if not NULL */
+}
+PutxTemplate;
+
+/* ----------------------------------------------------------------------------
+ * web::putxfile keeps the templates of a file per interp. The content is
+ * taken from the process-wide source cache (see srccache.h), the file is
+ * checked at most every outData->putxFileCheck seconds.
+ * ------------------------------------------------------------------------- */
+typedef struct PutxFile
+{
+    long mtime;			/* of the file the templates were made of */
+    long size;
+    long checked;		/* time of the last check */
+    long lastUsed;
+    PutxTemplate *tmpl[PUTXMARKUPS];
+}
+PutxFile;
+
+PutxTemplate *putxCompile(Tcl_Obj * in, TCLCONST char *strstart,
+			  TCLCONST char *strend, int braceVars);
+int putxEval(Tcl_Interp * interp, OutData * outData,
+	     ResponseObj * responseObj, PutxTemplate * tmpl, int flags);
+void putxRelease(PutxTemplate * tmpl);
+
+#endif
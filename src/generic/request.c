@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include "log.h"
 #include "cfg.h"
+#include "reset.h"
 
 #ifdef WIN32
 #include <errno.h>
@@ -32,6 +33,14 @@ void destroyRequestDataHook(ClientData clientData)
     destroyRequestData(clientData, NULL);
 }
 
+/* ----------------------------------------------------------------------------
+ * resetRequestHook -- per-request reset hook, see reset.h
+ * ------------------------------------------------------------------------- */
+static int resetRequestHook(Tcl_Interp * interp, ClientData clientData)
+{
+    return resetRequestData(interp, (RequestData *) clientData);
+}
+
 /* ----------------------------------------------------------------------------
  * Init --
  * ------------------------------------------------------------------------- */
@@ -83,6 +92,9 @@ int request_Init(Tcl_Interp * interp)
     Tcl_SetAssocData(interp, WEB_REQ_ASSOC_DATA,
 		     destroyRequestData, (ClientData) requestData);
 
+    webRegisterReset(interp, WEB_RESET_ALL,
+		     resetRequestHook, (ClientData) requestData);
+
     /* -------------------------------------------------------------------------
      * we need an exit handler (if this is the main interp)
      * because we need to delete temp files on regular exit too
@@ -448,9 +460,9 @@ int Web_Request(ClientData clientData,
 		Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
 {
 
-    static char *params[] = { "-reset", "-channel", NULL };
+    static char *params[] = { "-reset", "-channel", "-timing", NULL };
     enum params
-    { REQUESTRESET, DEFAULTCHANNELNAME };
+    { REQUESTRESET, DEFAULTCHANNELNAME, REQUESTTIMING };
 
     int res;
     RequestData *requestData;
@@ -484,6 +496,10 @@ int Web_Request(ClientData clientData,
 	case REQUESTRESET:
 	    return resetRequestData(interp, requestData);
 	    break;
+	case REQUESTTIMING:
+	    Tcl_SetObjResult(interp, requestGetTiming(interp));
+	    return TCL_OK;
+	    break;
 	default:
 	    break;
 	}
@@ -195,6 +195,7 @@ char *mimeGetParameterFromContDisp(const char *contentDisp, const char *name);
  * in httpd case: implemented in mod_websh.c */
 Tcl_Obj *requestGetDefaultChannelName(Tcl_Interp *interp);
 char *requestGetDefaultOutChannelName(Tcl_Interp *interp);
+Tcl_Obj *requestGetTiming(Tcl_Interp *interp);
 
 int requestFillRequestValues(Tcl_Interp * interp, RequestData * requestData);
 
@@ -21,6 +21,7 @@
 #include <ctype.h>        // for isspace
 
 #include "mod_websh.h"
+#include "interpool.h"
 
 #ifdef APACHE2
 #include "apr_base64.h"
@@ -41,6 +42,18 @@ char *requestGetDefaultOutChannelName_AP(Tcl_Interp * interp)
     return APCHANNEL;
 }
 
+/* web::request -timing: phases of the current request so far (usec) */
+
+Tcl_Obj *requestGetTiming_AP(Tcl_Interp * interp)
+{
+    WebInterp *webInterp = (WebInterp *) Tcl_GetAssocData(interp, WEB_INTERP_ASSOC_DATA, NULL);
+
+    if (webInterp == NULL)
+	return Tcl_NewObj();
+
+    return webInterpTimingObj(webInterp->timing, (long) apr_time_now());
+}
+
 int requestFillRequestValues_AP(Tcl_Interp * interp, RequestData * requestData)
 {
 
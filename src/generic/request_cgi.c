@@ -45,6 +45,17 @@ char *requestGetDefaultOutChannelName(Tcl_Interp * interp)
     return CGICHANNEL;
 }
 
+/* web::request -timing: phases of the request (mod_websh only) */
+
+Tcl_Obj *requestGetTiming(Tcl_Interp * interp)
+{
+    ApFuncs *apFuncs = Tcl_GetAssocData(interp, WEB_APFUNCS_ASSOC_DATA, NULL);
+    if (apFuncs != NULL)
+      return apFuncs->requestGetTiming(interp);
+
+    return Tcl_NewObj();
+}
+
 
 int requestFillRequestValues(Tcl_Interp * interp, RequestData * requestData)
 {
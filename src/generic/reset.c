@@ -0,0 +1,246 @@
+/*
+ * reset.c --- per-request reset of the websh modules
+ * nca-073-9
+ * 
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include "tcl.h"
+#include "webutl.h"
+#include "log.h"
+#include "reset.h"
+
+/* ----------------------------------------------------------------------------
+ * destroyResetData
+ * ------------------------------------------------------------------------- */
+static void destroyResetData(ClientData clientData, Tcl_Interp * interp)
+{
+
+    ResetData *resetData = (ResetData *) clientData;
+
+    if (resetData == NULL)
+	return;
+
+    WebFreeIfNotNull(resetData->hooks);
+    WebDecrRefCountIfNotNull(resetData->onexit);
+    WebDecrRefCountIfNotNull(resetData->deferred);
+    WebFreeIfNotNull(resetData);
+}
+
+/* ----------------------------------------------------------------------------
+ * getResetData -- created with the first hook
+ * ------------------------------------------------------------------------- */
+static ResetData *getResetData(Tcl_Interp * interp)
+{
+
+    ResetData *resetData;
+
+    resetData =
+	(ResetData *) Tcl_GetAssocData(interp, WEB_RESET_ASSOC_DATA, NULL);
+    if (resetData != NULL)
+	return resetData;
+
+    resetData = WebAllocInternalData(ResetData);
+    if (resetData == NULL)
+	return NULL;
+
+    resetData->hooks = NULL;
+    resetData->numHooks = 0;
+    resetData->size = 0;
+    resetData->onexit = NULL;
+    resetData->deferred = NULL;
+
+    Tcl_SetAssocData(interp, WEB_RESET_ASSOC_DATA,
+		     destroyResetData, (ClientData) resetData);
+
+    return resetData;
+}
+
+/* ----------------------------------------------------------------------------
+ * Init --
+ * ------------------------------------------------------------------------- */
+int reset_Init(Tcl_Interp * interp)
+{
+
+    ResetData *resetData;
+
+    if (interp == NULL)
+	return TCL_ERROR;
+
+    resetData = getResetData(interp);
+    WebAssertData(interp, resetData, "reset", TCL_ERROR);
+
+    Tcl_CreateObjCommand(interp, "web::onexit",
+			 Web_OnExit,
+			 (ClientData) resetData, (Tcl_CmdDeleteProc *) NULL);
+
+    Tcl_CreateObjCommand(interp, "web::defer",
+			 Web_Defer,
+			 (ClientData) resetData, (Tcl_CmdDeleteProc *) NULL);
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * webRegisterReset -- add a hook for WEB_RESET_INIT and/or WEB_RESET_CLEANUP
+ * ------------------------------------------------------------------------- */
+int webRegisterReset(Tcl_Interp * interp, int when, WebResetProc * proc,
+		     ClientData clientData)
+{
+
+    ResetData *resetData = getResetData(interp);
+
+    if (resetData == NULL || proc == NULL)
+	return TCL_ERROR;
+
+    if (resetData->numHooks == resetData->size) {
+	resetData->size += 8;
+	resetData->hooks =
+	    (ResetHook *) Tcl_Realloc((char *) resetData->hooks,
+				      resetData->size * sizeof(ResetHook));
+    }
+
+    resetData->hooks[resetData->numHooks].when = when;
+    resetData->hooks[resetData->numHooks].proc = proc;
+    resetData->hooks[resetData->numHooks].clientData = clientData;
+    resetData->numHooks++;
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * runQueue -- eval the commands of web::onexit or web::defer at global
+ * level. Commands queued meanwhile are dropped.
+ * ------------------------------------------------------------------------- */
+static void runQueue(Tcl_Interp * interp, Tcl_Obj ** queue, char *cmd,
+		     int logErrors)
+{
+
+    Tcl_Obj *commands = *queue;
+    Tcl_Obj **command = NULL;
+    int num = 0;
+    int i;
+
+    if (commands == NULL)
+	return;
+
+    *queue = NULL;
+
+    if (Tcl_ListObjGetElements(NULL, commands, &num, &command) == TCL_OK) {
+	for (i = 0; i < num; i++) {
+	    if (Tcl_EvalObjEx(interp, command[i], TCL_EVAL_GLOBAL) != TCL_OK
+		&& logErrors) {
+		LOG_MSG(interp, WRITE_LOG | INTERP_ERRORINFO,
+			__FILE__, __LINE__,
+			cmd, WEBLOG_ERROR,
+			(char *) Tcl_GetStringResult(interp), NULL);
+	    }
+	}
+    }
+
+    Tcl_DecrRefCount(commands);
+    WebDecrRefCountIfNotNullAndSetNull(*queue);
+    Tcl_ResetResult(interp);
+}
+
+/* ----------------------------------------------------------------------------
+ * appendQueue -- add command to the queue of web::onexit or web::defer
+ * ------------------------------------------------------------------------- */
+static int appendQueue(Tcl_Interp * interp, Tcl_Obj ** queue,
+		       Tcl_Obj * command)
+{
+
+    if (*queue == NULL) {
+	*queue = Tcl_NewObj();
+	Tcl_IncrRefCount(*queue);
+    } else if (Tcl_IsShared(*queue)) {
+	Tcl_Obj *copy = Tcl_DuplicateObj(*queue);
+	Tcl_DecrRefCount(*queue);
+	*queue = copy;
+	Tcl_IncrRefCount(*queue);
+    }
+
+    return Tcl_ListObjAppendElement(interp, *queue, command);
+}
+
+/* ----------------------------------------------------------------------------
+ * webResetRequest -- reset all modules. Stops at the first hook that fails.
+ * ------------------------------------------------------------------------- */
+int webResetRequest(Tcl_Interp * interp, int when)
+{
+
+    ResetData *resetData;
+    int i;
+
+    resetData =
+	(ResetData *) Tcl_GetAssocData(interp, WEB_RESET_ASSOC_DATA, NULL);
+    if (resetData == NULL)
+	return TCL_OK;
+
+    if (when == WEB_RESET_INIT) {
+	WebDecrRefCountIfNotNullAndSetNull(resetData->onexit);
+	WebDecrRefCountIfNotNullAndSetNull(resetData->deferred);
+	for (i = 0; i < resetData->numHooks; i++) {
+	    if ((resetData->hooks[i].when & when)
+		&& resetData->hooks[i].proc(interp,
+					    resetData->hooks[i].clientData)
+		!= TCL_OK)
+		return TCL_ERROR;
+	}
+    } else {
+	runQueue(interp, &(resetData->onexit), "web::onexit", 0);
+	runQueue(interp, &(resetData->deferred), "web::defer", 1);
+	for (i = resetData->numHooks - 1; i >= 0; i--) {
+	    if ((resetData->hooks[i].when & when)
+		&& resetData->hooks[i].proc(interp,
+					    resetData->hooks[i].clientData)
+		!= TCL_OK)
+		return TCL_ERROR;
+	}
+    }
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Web_OnExit -- web::onexit command: eval command after the request
+ * ------------------------------------------------------------------------- */
+int Web_OnExit(ClientData clientData,
+	       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+
+    ResetData *resetData;
+
+    WebAssertData(interp, clientData, "web::onexit", TCL_ERROR)
+	resetData = (ResetData *) clientData;
+
+    WebAssertObjc(objc != 2, 1, "command");
+
+    return appendQueue(interp, &(resetData->onexit), objv[1]);
+}
+
+/* ----------------------------------------------------------------------------
+ * Web_Defer -- web::defer command: eval script after the response has been
+ * sent, errors are logged
+ * ------------------------------------------------------------------------- */
+int Web_Defer(ClientData clientData,
+	      Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+
+    ResetData *resetData;
+
+    WebAssertData(interp, clientData, "web::defer", TCL_ERROR)
+	resetData = (ResetData *) clientData;
+
+    WebAssertObjc(objc != 2, 1, "script");
+
+    return appendQueue(interp, &(resetData->deferred), objv[1]);
+}
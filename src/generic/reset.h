@@ -0,0 +1,68 @@
+/*
+ * reset.h --- per-request reset of the websh modules
+ * nca-073-9
+ * 
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include "tcl.h"
+
+#ifndef RESET_H
+#define RESET_H
+
+#define WEB_RESET_ASSOC_DATA "web::resetData"
+
+/* ----------------------------------------------------------------------------
+ * when a reset hook is called
+ * ------------------------------------------------------------------------- */
+#define WEB_RESET_INIT    1	/* before the script of a request */
+#define WEB_RESET_CLEANUP 2	/* after the script of a request */
+#define WEB_RESET_ALL     (WEB_RESET_INIT | WEB_RESET_CLEANUP)
+
+/* ----------------------------------------------------------------------------
+ * every module registers a C function that resets its per-request data.
+ * mod_websh calls them directly instead of evaluating Tcl code, init hooks
+ * in the order of registration, cleanup hooks in reverse order after the
+ * commands registered with web::onexit and web::defer. The cleanup runs
+ * after the response has been sent to the client.
+ * ------------------------------------------------------------------------- */
+typedef int (WebResetProc) (Tcl_Interp * interp, ClientData clientData);
+
+typedef struct ResetHook
+{
+    int when;
+    WebResetProc *proc;
+    ClientData clientData;
+}
+ResetHook;
+
+typedef struct ResetData
+{
+    ResetHook *hooks;
+    int numHooks;
+    int size;
+    Tcl_Obj *onexit;		/* list of commands, errors are ignored */
+    Tcl_Obj *deferred;		/* list of commands, errors are logged */
+}
+ResetData;
+
+int reset_Init(Tcl_Interp * interp);
+
+int webRegisterReset(Tcl_Interp * interp, int when, WebResetProc * proc,
+		     ClientData clientData);
+int webResetRequest(Tcl_Interp * interp, int when);
+
+int Web_OnExit(ClientData clientData,
+	       Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+int Web_Defer(ClientData clientData,
+	      Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+
+#endif
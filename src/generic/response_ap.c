@@ -21,6 +21,7 @@
 #include "webout.h"
 
 #include "request.h"
+#include "interpool.h"
 
 #ifdef APACHE2
 #include "apr_strings.h"
@@ -141,6 +142,40 @@ int apHeaderHandler(Tcl_Interp * interp, ResponseObj * responseObj,
 	/* ap_send_http_header(r); */
 #endif /* APACHE2 */
 	responseObj->sendHeader = 0;
+
+#ifdef APACHE2
+	{
+	    WebInterp *webInterp = (WebInterp *) Tcl_GetAssocData(interp, WEB_INTERP_ASSOC_DATA, NULL);
+	    if (webInterp != NULL) {
+		long now = (long) apr_time_now();
+		webInterp->timing[WIP_PHASE_FIRSTBYTE] = now;
+		/* only what happened up to now (the headers go out first) */
+		if (webInterp->interpClass->conf->serverTiming)
+		    apr_table_set(r->headers_out, "Server-Timing",
+				  webInterpTimingString(r->pool, webInterp->timing, now, 1));
+	    }
+	}
+#endif /* APACHE2 */
+    }
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * apFlushHandler -- web::response -flush: send it to the client now
+ * ------------------------------------------------------------------------- */
+int apFlushHandler(Tcl_Interp * interp, ResponseObj * responseObj)
+{
+
+    request_rec *r = NULL;
+
+    r = (request_rec *) Tcl_GetAssocData(interp, WEB_AP_ASSOC_DATA, NULL);
+    if (r == NULL) {
+	Tcl_SetResult(interp, "error accessing httpd request object", NULL);
+	return TCL_ERROR;
+    }
+    if (ap_rflush(r) < 0) {
+	Tcl_SetResult(interp, "error flushing response", NULL);
+	return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -150,7 +185,12 @@ int apHeaderHandler(Tcl_Interp * interp, ResponseObj * responseObj,
  * ------------------------------------------------------------------------- */
 ResponseObj *createDefaultResponseObj_AP(Tcl_Interp * interp)
 {
-    return createResponseObj(interp, APCHANNEL, &apHeaderHandler);
+    ResponseObj *responseObj;
+
+    responseObj = createResponseObj(interp, APCHANNEL, &apHeaderHandler);
+    if (responseObj != NULL)
+	responseObj->flushHandler = &apFlushHandler;
+    return responseObj;
 }
 
 /* ----------------------------------------------------------------------------
@@ -1,7 +1,7 @@
 /*
  * script.c --- the commands of websh3 that are implemented as Tcl scripts
  * nca-073-9
- * 
+ *
  * Copyright (c) 1996-2000 by Netcetera AG.
  * Copyright (c) 2001 by Apache Software Foundation.
  * All rights reserved.
@@ -13,19 +13,74 @@
  *
  */
 #include <tcl.h>
+
+/* ----------------------------------------------------------------------------
+ * ScriptProc -- a proc of the Websh library, split by tcldecmt.tcl
+ * ------------------------------------------------------------------------- */
+typedef struct ScriptProc
+{
+    const char *name;
+    const char *args;
+    const char *body;
+}
+ScriptProc;
+
 #include "script.h"
 
+/* ----------------------------------------------------------------------------
+ * defineScriptProc -- call proc with the parts of scriptProc: the library
+ * source is not parsed again, the body is compiled on the first call
+ * ------------------------------------------------------------------------- */
+static int defineScriptProc(Tcl_Interp * interp, Tcl_Obj * procCmd,
+			    const ScriptProc * scriptProc)
+{
+    Tcl_Obj *objv[4];
+    int res, i;
+
+    objv[0] = procCmd;
+    objv[1] = Tcl_NewStringObj(scriptProc->name, -1);
+    objv[2] = Tcl_NewStringObj(scriptProc->args, -1);
+    objv[3] = Tcl_NewStringObj(scriptProc->body, -1);
+    for (i = 1; i < 4; i++)
+	Tcl_IncrRefCount(objv[i]);
+
+    res = Tcl_EvalObjv(interp, 4, objv, TCL_EVAL_GLOBAL);
+
+    for (i = 1; i < 4; i++)
+	Tcl_DecrRefCount(objv[i]);
+
+    return res;
+}
+
 /* ----------------------------------------------------------------------------
  * init --
  * ------------------------------------------------------------------------- */
 int Script_Init(Tcl_Interp * interp)
 {
 
+    const ScriptProc *scriptProc;
+    Tcl_Obj *procCmd;
+    int res = TCL_OK;
+
     if (interp == NULL)
 	return TCL_ERROR;
 
     /* --------------------------------------------------------------------------
      * eval code
      * ----------------------------------------------------------------------- */
-    return Tcl_Eval(interp, script_h);
+    if (Tcl_Eval(interp, script_h) != TCL_OK)
+	return TCL_ERROR;
+
+    /* --------------------------------------------------------------------------
+     * define procs
+     * ----------------------------------------------------------------------- */
+    procCmd = Tcl_NewStringObj("::proc", -1);
+    Tcl_IncrRefCount(procCmd);
+    for (scriptProc = script_procs; scriptProc->name != NULL; scriptProc++) {
+	if ((res = defineScriptProc(interp, procCmd, scriptProc)) != TCL_OK)
+	    break;
+    }
+    Tcl_DecrRefCount(procCmd);
+
+    return res;
 }
@@ -0,0 +1,345 @@
+/*
+ * srccache.c -- process-wide cache of script and template sources
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#include <tcl.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "hashutl.h"
+#include "macros.h"
+#include "srccache.h"
+
+static Tcl_HashTable *sourceCache = NULL;
+TCL_DECLARE_MUTEX(sourceCacheLock)
+
+/* ----------------------------------------------------------------------------
+ * isPlainUtf8 -- true if buf can be used as string rep without conversion:
+ * well-formed UTF-8 of at most 3 bytes per char, no NUL and no CR (the
+ * channel would translate line endings)
+ * ------------------------------------------------------------------------- */
+static int isPlainUtf8(const unsigned char *buf, long length)
+{
+    const unsigned char *end = buf + length;
+
+    while (buf < end) {
+	unsigned char c = *buf;
+	if (c < 0x80) {
+	    if (c == '\0' || c == '\r')
+		return 0;
+	    buf++;
+	} else if ((c & 0xE0) == 0xC0) {
+	    if (c < 0xC2 || end - buf < 2 || (buf[1] & 0xC0) != 0x80)
+		return 0;
+	    buf += 2;
+	} else if ((c & 0xF0) == 0xE0) {
+	    if (end - buf < 3 || (buf[1] & 0xC0) != 0x80
+		|| (buf[2] & 0xC0) != 0x80)
+		return 0;
+	    /* overlong or surrogate */
+	    if ((c == 0xE0 && buf[1] < 0xA0) || (c == 0xED && buf[1] >= 0xA0))
+		return 0;
+	    buf += 3;
+	} else {
+	    /* 4 byte sequences and invalid bytes: let Tcl convert them */
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * freeSourceCacheEntry
+ * ------------------------------------------------------------------------- */
+static void freeSourceCacheEntry(SourceCacheEntry * entry)
+{
+    if (entry == NULL)
+	return;
+    if (entry->data != NULL)
+	Tcl_Free(entry->data);
+    Tcl_Free((char *) entry);
+}
+
+/* ----------------------------------------------------------------------------
+ * readRaw -- Tcl_Alloc'ed copy of the bytes of the file. It is not mapped:
+ * a file truncated in place while mapped would raise SIGBUS.
+ * ------------------------------------------------------------------------- */
+static char *readRaw(Tcl_Interp * interp, char *filename, long size,
+		     long *length)
+{
+    char *raw = NULL;
+
+    *length = 0;
+
+#ifndef WIN32
+    {
+	int fd = open(filename, O_RDONLY);
+	if (fd >= 0) {
+	    long allocated = size + 1;
+	    long got = 0;
+	    ssize_t n;
+
+	    raw = Tcl_Alloc(allocated);
+	    /* the file may have grown since the stat */
+	    for (;;) {
+		if (got + 1 >= allocated) {
+		    allocated *= 2;
+		    raw = Tcl_Realloc(raw, allocated);
+		}
+		n = read(fd, raw + got, (size_t) (allocated - got - 1));
+		if (n <= 0)
+		    break;
+		got += n;
+	    }
+	    close(fd);
+	    if (n == 0) {
+		raw[got] = '\0';
+		*length = got;
+		return raw;
+	    }
+	    Tcl_Free(raw);
+	    raw = NULL;
+	}
+    }
+#endif
+
+    {
+	Tcl_Channel chan;
+	Tcl_Obj *bytes = NULL;
+	unsigned char *buf;
+	int len = 0;
+
+	chan = Tcl_OpenFileChannel(interp, filename, "r", 0644);
+	if (chan == (Tcl_Channel) NULL)
+	    return NULL;
+	Tcl_SetChannelOption(NULL, chan, "-translation", "binary");
+	bytes = Tcl_NewObj();
+	Tcl_IncrRefCount(bytes);
+	if (Tcl_ReadChars(chan, bytes, -1, 0) < 0) {
+	    Tcl_Close(NULL, chan);
+	    Tcl_DecrRefCount(bytes);
+	    Tcl_AppendResult(interp, "couldn't read file \"", filename,
+			     "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()), (char *) NULL);
+	    return NULL;
+	}
+	Tcl_Close(NULL, chan);
+	buf = Tcl_GetByteArrayFromObj(bytes, &len);
+	raw = Tcl_Alloc(len + 1);
+	memcpy(raw, buf, len);
+	raw[len] = '\0';
+	*length = len;
+	Tcl_DecrRefCount(bytes);
+    }
+    return raw;
+}
+
+/* ----------------------------------------------------------------------------
+ * loadSourceCacheEntry -- read file and convert it to UTF-8 the way
+ * Tcl_ReadChars with default channel settings would
+ * ------------------------------------------------------------------------- */
+static SourceCacheEntry *loadSourceCacheEntry(Tcl_Interp * interp,
+					      char *filename,
+					      struct stat *statPtr)
+{
+    SourceCacheEntry *entry = NULL;
+    char *raw = NULL;
+    long length = 0;
+
+    raw = readRaw(interp, filename, (long) statPtr->st_size, &length);
+    if (raw == NULL) {
+	if (!strlen(Tcl_GetStringResult(interp)))
+	    Tcl_AppendResult(interp, "couldn't read file \"", filename,
+			     "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()), (char *) NULL);
+	return NULL;
+    }
+
+    entry = WebAllocInternalData(SourceCacheEntry);
+    /* a file changed while read gets read again with the next stat */
+    entry->mtime = (long) statPtr->st_mtime;
+    entry->size = (long) statPtr->st_size;
+
+    if (!strcmp(Tcl_GetEncodingName(NULL), "utf-8")
+	&& isPlainUtf8((unsigned char *) raw, length)) {
+	/* use the bytes as they are */
+	entry->data = raw;
+	entry->length = (int) length;
+    } else {
+	Tcl_DString ds;
+	char *src, *dst, *end;
+
+	Tcl_DStringInit(&ds);
+	Tcl_ExternalToUtfDString(NULL, raw, (int) length, &ds);
+	Tcl_Free(raw);
+
+	/* -translation auto: \r\n and \r become \n */
+	entry->data = Tcl_Alloc(Tcl_DStringLength(&ds) + 1);
+	src = Tcl_DStringValue(&ds);
+	end = src + Tcl_DStringLength(&ds);
+	dst = entry->data;
+	while (src < end) {
+	    if (*src == '\r') {
+		*dst++ = '\n';
+		if (src + 1 < end && src[1] == '\n')
+		    src++;
+		src++;
+	    } else {
+		*dst++ = *src++;
+	    }
+	}
+	*dst = '\0';
+	entry->length = (int) (dst - entry->data);
+	Tcl_DStringFree(&ds);
+    }
+
+    return entry;
+}
+
+/* ----------------------------------------------------------------------------
+ * isCurrentEntry -- true if entry holds the version described by statPtr
+ * ------------------------------------------------------------------------- */
+static int isCurrentEntry(SourceCacheEntry * entry, struct stat *statPtr)
+{
+    return entry->mtime == (long) statPtr->st_mtime
+	&& entry->size == (long) statPtr->st_size;
+}
+
+/* ----------------------------------------------------------------------------
+ * sourceCacheGetObj -- new string object with the content of filename.
+ * Reads the file only if it is not cached or has changed since. Sets
+ * mtime to the mtime of the returned version. On error, leaves a message
+ * in interp and returns NULL.
+ * The file is read and converted without holding sourceCacheLock, so a
+ * slow file system only blocks the threads that need this very file.
+ * ------------------------------------------------------------------------- */
+Tcl_Obj *sourceCacheGetObj(Tcl_Interp * interp, char *filename, long *mtime)
+{
+    struct stat statBuf;
+    Tcl_HashEntry *hashEntry;
+    SourceCacheEntry *entry = NULL;
+    SourceCacheEntry *loaded = NULL;
+    Tcl_Obj *objPtr = NULL;
+    int isNew = 0;
+
+    if (Tcl_Stat(filename, &statBuf) != 0) {
+	Tcl_ResetResult(interp);
+	Tcl_AppendResult(interp, "couldn't read file \"", filename,
+			 "\": ", Tcl_ErrnoMsg(Tcl_GetErrno()), (char *) NULL);
+	return NULL;
+    }
+
+    /* --------------------------------------------------------------------------
+     * cached and unchanged
+     * ----------------------------------------------------------------------- */
+    Tcl_MutexLock(&sourceCacheLock);
+
+    if (sourceCache != NULL) {
+	hashEntry = Tcl_FindHashEntry(sourceCache, filename);
+	if (hashEntry != NULL) {
+	    entry = (SourceCacheEntry *) Tcl_GetHashValue(hashEntry);
+	    if (isCurrentEntry(entry, &statBuf)) {
+		/* the copy is made while locked, entry might be replaced
+		 * afterwards */
+		objPtr = Tcl_NewStringObj(entry->data, entry->length);
+		if (mtime != NULL)
+		    *mtime = entry->mtime;
+		Tcl_MutexUnlock(&sourceCacheLock);
+		return objPtr;
+	    }
+	}
+    }
+
+    Tcl_MutexUnlock(&sourceCacheLock);
+
+    /* --------------------------------------------------------------------------
+     * read and convert unlocked
+     * ----------------------------------------------------------------------- */
+    loaded = loadSourceCacheEntry(interp, filename, &statBuf);
+    if (loaded == NULL)
+	return NULL;
+
+    /* --------------------------------------------------------------------------
+     * insert: keep the entry of a thread that read the same version first
+     * ----------------------------------------------------------------------- */
+    Tcl_MutexLock(&sourceCacheLock);
+
+    if (sourceCache == NULL) {
+	HashUtlAllocInit(sourceCache, TCL_STRING_KEYS);
+    }
+
+    hashEntry = Tcl_CreateHashEntry(sourceCache, filename, &isNew);
+    entry = isNew ? NULL : (SourceCacheEntry *) Tcl_GetHashValue(hashEntry);
+    if (entry != NULL && isCurrentEntry(entry, &statBuf)) {
+	freeSourceCacheEntry(loaded);
+    } else {
+	/* new or changed: all threads get this version from now on */
+	freeSourceCacheEntry(entry);
+	entry = loaded;
+	Tcl_SetHashValue(hashEntry, (ClientData) entry);
+    }
+
+    objPtr = Tcl_NewStringObj(entry->data, entry->length);
+    if (mtime != NULL)
+	*mtime = entry->mtime;
+
+    Tcl_MutexUnlock(&sourceCacheLock);
+
+    return objPtr;
+}
+
+/* ----------------------------------------------------------------------------
+ * sourceCacheFlush -- forget filename (NULL: forget all)
+ * ------------------------------------------------------------------------- */
+void sourceCacheFlush(char *filename)
+{
+    Tcl_HashEntry *hashEntry;
+    Tcl_HashSearch search;
+
+    Tcl_MutexLock(&sourceCacheLock);
+
+    if (sourceCache != NULL) {
+	if (filename != NULL) {
+	    hashEntry = Tcl_FindHashEntry(sourceCache, filename);
+	    if (hashEntry != NULL) {
+		freeSourceCacheEntry((SourceCacheEntry *) Tcl_GetHashValue(hashEntry));
+		Tcl_DeleteHashEntry(hashEntry);
+	    }
+	} else {
+	    while ((hashEntry = Tcl_FirstHashEntry(sourceCache, &search)) != NULL) {
+		freeSourceCacheEntry((SourceCacheEntry *) Tcl_GetHashValue(hashEntry));
+		Tcl_DeleteHashEntry(hashEntry);
+	    }
+	}
+    }
+
+    Tcl_MutexUnlock(&sourceCacheLock);
+}
+
+/* ----------------------------------------------------------------------------
+ * sourceCacheFinalize -- free the cache (server restart)
+ * ------------------------------------------------------------------------- */
+void sourceCacheFinalize(void)
+{
+    sourceCacheFlush(NULL);
+
+    Tcl_MutexLock(&sourceCacheLock);
+    if (sourceCache != NULL) {
+	HashUtlDelFree(sourceCache);
+	sourceCache = NULL;
+    }
+    Tcl_MutexUnlock(&sourceCacheLock);
+}
@@ -0,0 +1,43 @@
+/*
+ * srccache.h -- process-wide cache of script and template sources
+ * nca-073-9
+ *
+ * Copyright (c) 1996-2000 by Netcetera AG.
+ * Copyright (c) 2001 by Apache Software Foundation.
+ * All rights reserved.
+ *
+ * See the file "license.terms" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ *
+ * @(#) $Id$
+ *
+ */
+
+#ifndef WEB_SRCCACHE_H
+#define WEB_SRCCACHE_H
+
+#include "tcl.h"
+
+/* ----------------------------------------------------------------------------
+ * the cache is shared by all threads of the process, one entry per file.
+ * - key is the file name
+ * - entry holds the UTF-8 source, valid as long as mtime and size match
+ * Tcl_Objs can not be shared between threads, so every thread creates its
+ * own string object from the entry. The file is read at most once per
+ * version though.
+ * ------------------------------------------------------------------------- */
+
+typedef struct SourceCacheEntry
+{
+    long mtime;			/* mtime of the file when it was read */
+    long size;			/* size of the file when it was read */
+    char *data;			/* UTF-8 source */
+    int length;			/* length of data in bytes */
+}
+SourceCacheEntry;
+
+Tcl_Obj *sourceCacheGetObj(Tcl_Interp * interp, char *filename, long *mtime);
+void sourceCacheFlush(char *filename);
+void sourceCacheFinalize(void);
+
+#endif
@@ -1,5 +1,8 @@
 # 
 # tcldecmt.tcl -- strip white space and some comments from Tcl source code.
+# Writes the code as C strings: procs with a qualified name go to the
+# table script_procs as name, args and body (see script.c), the rest to
+# script_h.
 
 # The comment stripper is rather simplistic and doesn't handle all
 # code perfectly.
@@ -21,33 +24,102 @@ proc DoFile { fileName } {
     # ----------------------------------------------------------------------------
     # read line by line to the end of the file
     # ----------------------------------------------------------------------------
+    set lines {}
     while {[eof $fileId] == 0} {
 
 	gets $fileId tLine
 	if { ![regexp "^$" $tLine] } {
 	    if { ![regexp {^[^#]*#} $tLine] } {
 		regsub -all {\s+} $tLine { } res
-		set res [string map {\" \\\" \\ \\\\} $res]
-		set tLine $res
-		if { [regexp {^\s*(.*)} $tLine dum res] } {
-		    puts "\"$res\\n\"\\"
-		} else {
-		    puts "\"$tLine\\n\"\\"
-		}
+		regexp {^\s*(.*)} $res dum res
+		lappend lines $res
 	    }
 	}
     }
+    close $fileId
+    return $lines
+}
+
+# ----------------------------------------------------------------------------
+# CString -- lines as C string literal
+# ----------------------------------------------------------------------------
+proc CString { lines } {
+    set res {}
+    foreach tLine $lines {
+	append res "\"[string map {\" \\\" \\ \\\\} $tLine]\\n\"\\\n"
+    }
+    return $res
+}
+
+# ----------------------------------------------------------------------------
+# CText -- text as C string literal, without a newline at the end
+# ----------------------------------------------------------------------------
+proc CText { text } {
+    set lines [split $text \n]
+    set res [CString [lrange $lines 0 end-1]]
+    append res "\"[string map {\" \\\" \\ \\\\} [lindex $lines end]]\""
+    return $res
+}
+
+# ----------------------------------------------------------------------------
+# ProcParts -- name, args and body of the proc command cmd, as the Tcl
+# parser passes them to proc
+# ----------------------------------------------------------------------------
+proc CaptureProc { name arglist body } {
+    global procParts
+    set procParts [list $arglist $body]
+}
+
+proc ProcParts { cmd } {
+    global procParts
+    set parser [interp create]
+    interp alias $parser proc {} CaptureProc
+    $parser eval [join $cmd \n]
+    interp delete $parser
+    return $procParts
 }
 
 if {$argc > 0 } {
+    # ----------------------------------------------------------------------------
+    # split into top level commands: procs with a qualified name are
+    # defined without parsing (script_procs), everything else is evaluated
+    # at init (script_h)
+    # ----------------------------------------------------------------------------
+    set eager {}
+    set procs {}
+    foreach fileName $argv {
+	set cmd {}
+	foreach tLine [DoFile $fileName] {
+	    lappend cmd $tLine
+	    if {![info complete [join $cmd \n]\n]} {
+		continue
+	    }
+	    if {[regexp {^proc (::)?(\w+::[\w:]+) } [lindex $cmd 0] dum dum name]} {
+		lappend procs $name $cmd
+	    } else {
+		eval lappend eager $cmd
+	    }
+	    set cmd {}
+	}
+	eval lappend eager $cmd
+    }
+
     # prologue
     puts "/* Do not modify! This code is automatically generated by $argv0 */"
     puts "char script_h\[\] = \\"
-    foreach fileName $argv {
-	DoFile $fileName
-    }
+    puts -nonewline [CString $eager]
     puts ";"
+    puts ""
+    puts "static const ScriptProc script_procs\[\] = {"
+    foreach {name cmd} $procs {
+	foreach {arglist body} [ProcParts $cmd] break
+	puts "{\"$name\","
+	puts "[CText $arglist],"
+	puts "[CText $body]},"
+    }
+    puts "{NULL, NULL, NULL}"
+    puts "};"
 } else {
-    puts stderr "$argv0 --- usage: hdb2pab.tcl input.hdb."
+    puts stderr "$argv0 --- usage: tcldecmt.tcl file ..."
     exit 1
 }
@@ -21,6 +21,7 @@
 #include "stdlib.h"		/* getenv */
 #include "log.h"
 #include "request.h"
+#include "reset.h"
 
 
 
@@ -65,6 +66,14 @@ enum urlElement
 };
 
 
+/* ----------------------------------------------------------------------------
+ * resetUrlHook -- per-request reset hook, see reset.h
+ * ------------------------------------------------------------------------- */
+static int resetUrlHook(Tcl_Interp * interp, ClientData clientData)
+{
+    return resetUrlData(interp, (UrlData *) clientData);
+}
+
 /* ----------------------------------------------------------------------------
  * Init --
  * ------------------------------------------------------------------------- */
@@ -99,6 +108,9 @@ int url_Init(Tcl_Interp * interp)
     Tcl_SetAssocData(interp, WEB_URL_ASSOC_DATA,
 		     destroyUrlData, (ClientData) urlData);
 
+    webRegisterReset(interp, WEB_RESET_ALL,
+		     resetUrlHook, (ClientData) urlData);
+
     /* --------------------------------------------------------------------------
      * done
      * ----------------------------------------------------------------------- */
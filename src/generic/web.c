@@ -18,113 +18,175 @@
 #include "nca_d.h"
 #include <stdio.h>
 #include "messages.h"
+#include "modwebsh_cgi.h"
 
 int modwebsh_createcmd(Tcl_Interp * interp);
 
 /* ----------------------------------------------------------------------------
- * init --
+ * interlink some data (needs request, url and log)
  * ------------------------------------------------------------------------- */
-int DLL_EXPORT Websh_Init(Tcl_Interp * interp)
+static int interlink_Init(Tcl_Interp * interp)
 {
 
     UrlData *urlData;
     RequestData *requestData;
     LogData *logData;
 
-    if (interp == NULL)
-	return TCL_ERROR;
+    requestData =
+	(RequestData *) Tcl_GetAssocData(interp, WEB_REQ_ASSOC_DATA, NULL);
+    urlData = (UrlData *) Tcl_GetAssocData(interp, WEB_URL_ASSOC_DATA, NULL);
+    logData =  (LogData *) Tcl_GetAssocData(interp, WEB_LOG_ASSOC_DATA, NULL);
 
-    /* --------------------------------------------------------------------------
-     * stubs
-     * ----------------------------------------------------------------------- */
-    Tcl_InitStubs(interp, "8.2", 0);
+    urlData->requestData = requestData;
+    logData->requestData = requestData;
 
-    /* --------------------------------------------------------------------------
-     * the encoding module (htmlify,uricode)
-     * ----------------------------------------------------------------------- */
-    if (conv_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    return TCL_OK;
+}
 
-    /* --------------------------------------------------------------------------
-     * output handler
-     * ----------------------------------------------------------------------- */
-    if (webout_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+/* ----------------------------------------------------------------------------
+ * the modules of websh, in the order they are initialized
+ * ------------------------------------------------------------------------- */
+typedef struct WebModule
+{
+    const char *name;
+    int (*init) (Tcl_Interp * interp);
+}
+WebModule;
+
+static const WebModule webModules[] = {
+    /* per-request reset (modules register their hooks), web::onexit */
+    {"reset", reset_Init},
+    /* the encoding module (htmlify,uricode) */
+    {"conv", conv_Init},
+    /* output handler */
+    {"webout", webout_Init},
+    /* messages on streams */
+    {"messages", messages_Init},
+    /* cryptography */
+    {"nca_d", nca_d_Init},
+    {"crypt", crypt_Init},
+    /* url generation */
+    {"url", url_Init},
+    /* request data management */
+    {"request", request_Init},
+    /* logging (needs to be after request_Init, because it needs requestData) */
+    {"log", log_Init},
+    /* filecounter (needs to be after request_Init, because it needs requestData) */
+    {"filecounter", filecounter_Init},
+    {"interlink", interlink_Init},
+    /* utilities */
+    {"webutlcmd", webutlcmd_Init},
+    /* config */
+    {"cfg", cfg_Init},
+    /* tcl-code */
+    {"script", Script_Init},
+    /* mod_websh look-alike */
+    {"modwebsh", modwebsh_createcmd},
+    {NULL, NULL}
+};
 
-    /* --------------------------------------------------------------------------
-     * messages on streams
-     * ----------------------------------------------------------------------- */
-    if (messages_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+/* ----------------------------------------------------------------------------
+ * initModules -- init all modules. If footprint is not NULL, appends the
+ * name of every module and the bytes its init allocated (see
+ * webThreadMemoryInUse).
+ * ------------------------------------------------------------------------- */
+static int initModules(Tcl_Interp * interp, Tcl_Obj * footprint)
+{
 
-    /* --------------------------------------------------------------------------
-     * cryptography
-     * ----------------------------------------------------------------------- */
-    if (nca_d_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    const WebModule *module;
+    Tcl_WideInt before = 0;
+    Tcl_WideInt used = 0;
+
+    for (module = webModules; module->name != NULL; module++) {
+	if (footprint != NULL)
+	    before = webThreadMemoryInUse();
+	if (module->init(interp) == TCL_ERROR)
+	    return TCL_ERROR;
+	if (footprint != NULL) {
+	    /* measure before the result list grows */
+	    used = (before < 0) ? -1 : webThreadMemoryInUse() - before;
+	    Tcl_ListObjAppendElement(NULL, footprint,
+				     Tcl_NewStringObj(module->name, -1));
+	    Tcl_ListObjAppendElement(NULL, footprint,
+				     Tcl_NewWideIntObj(used));
+	}
+    }
+    return TCL_OK;
+}
 
-    if (crypt_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+/* ----------------------------------------------------------------------------
+ * Web_Footprint -- web::footprint: bytes per module of a new interp.
+ * Creates and inits a scratch interp in the current thread, -1 if the Tcl
+ * allocator cannot tell.
+ * ------------------------------------------------------------------------- */
+static int Web_Footprint(ClientData clientData,
+			 Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
 
-    /* --------------------------------------------------------------------------
-     * url generation
-     * ----------------------------------------------------------------------- */
-    if (url_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    Tcl_Interp *scratch;
+    Tcl_Obj *footprint;
+    Tcl_Obj *modules;
+    Tcl_WideInt start, total;
+    ClientData apFuncs;
+    int res;
 
-    /* --------------------------------------------------------------------------
-     * request data management
-     * ----------------------------------------------------------------------- */
-    if (request_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    WebAssertObjc(objc != 1, 1, NULL);
 
-    /* --------------------------------------------------------------------------
-     * logging (needs to be after request_Init, because it needs requestData)
-     * ----------------------------------------------------------------------- */
-    if (log_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    start = webThreadMemoryInUse();
+    scratch = Tcl_CreateInterp();
+    total = (start < 0) ? -1 : webThreadMemoryInUse() - start;
 
-    /* --------------------------------------------------------------------------
-     * filecounter (needs to be after request_Init, because it needs requestData)
-     * ----------------------------------------------------------------------- */
-    if (filecounter_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    /* same flavour (mod_websh or CGI) as the calling interp */
+    apFuncs = Tcl_GetAssocData(interp, WEB_APFUNCS_ASSOC_DATA, NULL);
+    if (apFuncs != NULL)
+	Tcl_SetAssocData(scratch, WEB_APFUNCS_ASSOC_DATA, NULL, apFuncs);
 
-    /* --------------------------------------------------------------------------
-     * interlink some data
-     * ----------------------------------------------------------------------- */
-    requestData =
-	(RequestData *) Tcl_GetAssocData(interp, WEB_REQ_ASSOC_DATA, NULL);
-    urlData = (UrlData *) Tcl_GetAssocData(interp, WEB_URL_ASSOC_DATA, NULL);
-    logData =  (LogData *) Tcl_GetAssocData(interp, WEB_LOG_ASSOC_DATA, NULL);
+    footprint = Tcl_NewObj();
+    modules = Tcl_NewObj();
+    Tcl_ListObjAppendElement(NULL, footprint, Tcl_NewStringObj("tcl", -1));
+    Tcl_ListObjAppendElement(NULL, footprint, Tcl_NewWideIntObj(total));
 
-    urlData->requestData = requestData;
-    logData->requestData = requestData;
+    res = initModules(scratch, modules);
+    if (res == TCL_ERROR)
+	Tcl_SetObjResult(interp, Tcl_GetObjResult(scratch));
+    total = (start < 0) ? -1 : webThreadMemoryInUse() - start;
 
-    /* --------------------------------------------------------------------------
-     * utilities
-     * ----------------------------------------------------------------------- */
-    if (webutlcmd_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
+    Tcl_DeleteInterp(scratch);
 
-    /* --------------------------------------------------------------------------
-     * config
-     * ----------------------------------------------------------------------- */
-    if (cfg_Init(interp) == TCL_ERROR)
+    if (res == TCL_ERROR) {
+	Tcl_DecrRefCount(footprint);
+	Tcl_DecrRefCount(modules);
 	return TCL_ERROR;
+    }
 
-    /* --------------------------------------------------------------------------
-     * tcl-code
-     * ----------------------------------------------------------------------- */
-    if (Script_Init(interp) == TCL_ERROR)
+    Tcl_ListObjAppendElement(NULL, footprint, Tcl_NewStringObj("modules", -1));
+    Tcl_ListObjAppendElement(NULL, footprint, modules);
+    Tcl_ListObjAppendElement(NULL, footprint, Tcl_NewStringObj("total", -1));
+    Tcl_ListObjAppendElement(NULL, footprint, Tcl_NewWideIntObj(total));
+
+    Tcl_SetObjResult(interp, footprint);
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * init --
+ * ------------------------------------------------------------------------- */
+int DLL_EXPORT Websh_Init(Tcl_Interp * interp)
+{
+
+    if (interp == NULL)
 	return TCL_ERROR;
 
     /* --------------------------------------------------------------------------
-     * mod_websh look-alike
+     * stubs
      * ----------------------------------------------------------------------- */
-    if (modwebsh_createcmd(interp) == TCL_ERROR)
+    Tcl_InitStubs(interp, "8.2", 0);
+
+    if (initModules(interp, NULL) == TCL_ERROR)
 	return TCL_ERROR;
 
+    Tcl_CreateObjCommand(interp, "web::footprint", Web_Footprint, NULL, NULL);
+
     /* ------------------------------------------------------------------------
      * we provide the websh package
      * --------------------------------------------------------------------- */
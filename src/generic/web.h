@@ -31,6 +31,7 @@
 #include "cfg.h"
 #include "filecounter.h"
 #include "modwebsh.h"
+#include "reset.h"
 
 int DLL_EXPORT Websh_Init(Tcl_Interp * interp);
 int DLL_EXPORT ModWebsh_Init(Tcl_Interp * interp);
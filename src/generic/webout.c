@@ -21,8 +21,17 @@
 #include "hashutl.h"
 #include "request.h"
 #include "paramlist.h"		/* destroyParamList */
+#include "reset.h"
 
 
+/* ----------------------------------------------------------------------------
+ * resetOutHook -- per-request reset hook, see reset.h
+ * ------------------------------------------------------------------------- */
+static int resetOutHook(Tcl_Interp * interp, ClientData clientData)
+{
+    return resetOutData(interp, (OutData *) clientData);
+}
+
 /* ----------------------------------------------------------------------------
  * init -- start up output handler module of websh3
  * ------------------------------------------------------------------------- */
@@ -49,6 +58,9 @@ int webout_Init(Tcl_Interp * interp)
     Tcl_CreateObjCommand(interp, "web::putx",
 			 Web_Eval, (ClientData) outData, NULL);
 
+    Tcl_CreateObjCommand(interp, "web::putxfile",
+			 Web_PutxFile, (ClientData) outData, NULL);
+
     Tcl_CreateObjCommand(interp, "web::put",
 			 Web_Puts, (ClientData) outData, NULL);
 
@@ -66,6 +78,10 @@ int webout_Init(Tcl_Interp * interp)
     Tcl_SetAssocData(interp, WEB_OUT_ASSOC_DATA,
 		     (Tcl_InterpDeleteProc *) destroyOutData,
 		     (ClientData) outData);
+
+    webRegisterReset(interp, WEB_RESET_ALL,
+		     resetOutHook, (ClientData) outData);
+
     return TCL_OK;
 }
 
@@ -121,10 +137,12 @@ int Web_Eval(ClientData clientData,
 
     switch (outData->putxMarkup) {
     case brace:
-	retval = webout_eval_tag(interp, responseObj, code, "{", "}");
+	retval = webout_eval_cached(interp, outData, responseObj, code,
+				    "{", "}");
 	break;
     case tag:
-	retval = webout_eval_tag(interp, responseObj, code, "<?", "?>");
+	retval = webout_eval_cached(interp, outData, responseObj, code,
+				    "<?", "?>");
 	break;
     default:
 	LOG_MSG(interp, WRITE_LOG | SET_RESULT, __FILE__, __LINE__,
@@ -137,6 +155,82 @@ int Web_Eval(ClientData clientData,
     return retval;
 }
 
+/* ----------------------------------------------------------------------------
+ * Web_PutxFile -- the web::putxfile command. Returns the completion code
+ * of web::putx, the message is written to vmsg.
+ * ------------------------------------------------------------------------- */
+int Web_PutxFile(ClientData clientData,
+		 Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[])
+{
+    ResponseObj *savedObj = NULL;
+    ResponseObj *responseObj = NULL;
+    OutData *outData = NULL;
+    Tcl_Obj *file = NULL;
+    Tcl_Obj *msgVar = NULL;
+    int retval = 0;
+
+    /* --------------------------------------------------------------------------
+     * sanity
+     * ----------------------------------------------------------------------- */
+    WebAssertData(interp, clientData, "web::putxfile", TCL_ERROR);
+    outData = (OutData *) clientData;
+
+    /* --------------------------------------------------------------------------
+     * web::putxfile file ?channel? ?vmsg?
+     * 0             1     2          3
+     * ----------------------------------------------------------------------- */
+    WebAssertObjc((objc < 2) || (objc > 4), 1, "file ?channel? ?vmsg?");
+
+    savedObj = outData->defaultResponseObj;
+    responseObj = savedObj;
+    file = objv[1];
+    if (objc > 2 && Tcl_GetCharLength(objv[2]) > 0) {
+	/* file is actually the channel and channel is the file */
+	responseObj = getResponseObj(interp, outData, Tcl_GetString(objv[1]));
+	file = objv[2];
+    }
+    if (objc > 3 && Tcl_GetCharLength(objv[3]) > 0)
+	msgVar = objv[3];
+
+    if (responseObj == NULL) {
+
+	LOG_MSG(interp, WRITE_LOG | SET_RESULT, __FILE__, __LINE__,
+		"web::putxfile", WEBLOG_ERROR,
+		"error accessing response object", NULL);
+	retval = TCL_ERROR;
+    }
+    else {
+
+	outData->defaultResponseObj = responseObj;
+
+	switch (outData->putxMarkup) {
+	case brace:
+	    retval = webout_eval_file(interp, outData, responseObj,
+				      Tcl_GetString(file), "{", "}");
+	    break;
+	case tag:
+	    retval = webout_eval_file(interp, outData, responseObj,
+				      Tcl_GetString(file), "<?", "?>");
+	    break;
+	default:
+	    LOG_MSG(interp, WRITE_LOG | SET_RESULT, __FILE__, __LINE__,
+		    "web::putxfile", WEBLOG_ERROR,
+		    "unknown putxmarkup type", NULL);
+	    retval = TCL_ERROR;
+	    break;
+	}
+
+	outData->defaultResponseObj = savedObj;
+    }
+
+    if (msgVar != NULL
+	&& Tcl_ObjSetVar2(interp, msgVar, NULL, Tcl_GetObjResult(interp),
+			  TCL_LEAVE_ERR_MSG) == NULL)
+	return TCL_ERROR;
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(retval));
+    return TCL_OK;
+}
 
 /* ----------------------------------------------------------------------------
  * Web_Puts -- the web::puts command
@@ -217,11 +311,13 @@ int Web_Response(ClientData clientData, Tcl_Interp * interp,
 	"-channel",
 	"-encoding",
 	"-translation",
+	"-flush",
+	"-compression",
 	NULL
     };
     enum params
     { SENDHEADER, FIRSTBYTE, SELECT, BYTESSENT, HTTPRESPONSE, RESET, RESETALL,
-      OPT_CHANNEL, OPT_ENCODING, OPT_TRANSLATION
+      OPT_CHANNEL, OPT_ENCODING, OPT_TRANSLATION, OPT_FLUSH, OPT_COMPRESSION
     };
 
     /* --------------------------------------------------------------------------
@@ -301,6 +397,7 @@ int Web_Response(ClientData clientData, Tcl_Interp * interp,
 
 		    if (isDefaultResponseObj(interp, tname)) {
 			responseObj = createDefaultResponseObj(interp);
+			configureResponseObj(outData, responseObj);
 			/* add it to Hash Table */
 			if (appendToHashTable(outData->responseObjHash,
 					  Tcl_GetString(responseObj->name),
@@ -346,6 +443,9 @@ int Web_Response(ClientData clientData, Tcl_Interp * interp,
 		}
 	    case OPT_CHANNEL : {
               Tcl_Channel channel = getChannel(interp, responseObj);
+	      /* the caller is going to write to it directly */
+	      if (flushResponseObj(interp, responseObj, FLUSH_BUFFER) != TCL_OK)
+		  return TCL_ERROR;
 	      // Tcl_SetObjResult(interp, (Tcl_Obj *)channel);
               // Return channel object is ok. But return name for be able to print out.
               Tcl_SetResult(interp, (char *)Tcl_GetChannelName(channel), TCL_STATIC); // TCL_VOLATILE is not necessary;
@@ -358,6 +458,9 @@ int Web_Response(ClientData clientData, Tcl_Interp * interp,
 
 	      const char *name  = Tcl_GetString(objv[1]);
 	      const char *value = Tcl_GetString(objv[2]);
+	      /* what was put before is sent with the old settings */
+	      if (flushResponseObj(interp, responseObj, FLUSH_BUFFER) != TCL_OK)
+		  return TCL_ERROR;
               Tcl_SetChannelOption(interp, channel, name, value);
               // E.g. -encoding binary
               // E.g. -translation binary
@@ -395,8 +498,29 @@ int Web_Response(ClientData clientData, Tcl_Interp * interp,
 		    break;
 		}
 
+	    case OPT_FLUSH:{
+		    Tcl_Channel channel;
+		    WebAssertObjc(objc != 2, 2, NULL);
+		    if (flushResponseObj(interp, responseObj, FLUSH_SYNC) != TCL_OK)
+			return TCL_ERROR;
+		    channel = getChannel(interp, responseObj);
+		    if (channel == NULL)
+			return TCL_ERROR;
+		    Tcl_Flush(channel);
+		    if (responseObj->flushHandler != NULL)
+			return responseObj->flushHandler(interp, responseObj);
+		    return TCL_OK;
+		}
+
+	    case OPT_COMPRESSION:
+		WebAssertObjc(objc != 2, 2, NULL);
+		Tcl_SetObjResult(interp, responseCompressionStats(responseObj));
+		return TCL_OK;
+
 	    case BYTESSENT:
 		WebAssertObjc(objc != 2, 2, NULL);
+		if (flushResponseObj(interp, responseObj, FLUSH_BUFFER) != TCL_OK)
+		    return TCL_ERROR;
 		Tcl_SetObjResult(interp,
 				 Tcl_NewLongObj(responseObj->bytesSent));
 		return TCL_OK;
@@ -28,16 +28,38 @@
 #define HTTP_RESPONSE "HTTP/1.0 200 OK"
 #define HEADER "Content-Type","text/html", "Generator", WEBSH " " VERSION
 
+/* responses can be compressed with the zlib of Tcl */
+#if TCL_MAJOR_VERSION > 8 || (TCL_MAJOR_VERSION == 8 && TCL_MINOR_VERSION >= 6)
+#define WEBOUT_COMPRESS
+#endif
+
 /* ----------------------------------------------------------------------------
  * typedefs
  * ------------------------------------------------------------------------- */
 
 struct ResponseObj;
 
+/* what a flush of the output buffer stands for */
+typedef enum ResponseFlush
+{
+    FLUSH_BUFFER, FLUSH_SYNC, FLUSH_FINISH
+}
+ResponseFlush;
+
+typedef enum ResponseCompression
+{
+    COMPRESS_OFF, COMPRESS_UNDECIDED, COMPRESS_GZIP, COMPRESS_DEFLATE
+}
+ResponseCompression;
+
 typedef int (ResponseHeaderHandler) (Tcl_Interp * interp,
 				     struct ResponseObj * responseObj,
 				     Tcl_Obj * out);
 
+/* pushes what was written to the channel on to the client */
+typedef int (ResponseFlushHandler) (Tcl_Interp * interp,
+				    struct ResponseObj * responseObj);
+
 typedef struct ResponseObj
 {
     int sendHeader;
@@ -47,6 +69,18 @@ typedef struct ResponseObj
     Tcl_HashTable *headers;
     Tcl_Obj *name;
     Tcl_Obj *httpresponse;
+    ResponseFlushHandler *flushHandler;	/* NULL: Tcl_Flush is enough */
+    Tcl_Obj *buffer;		/* output not written to the channel yet */
+    int bufferLength;		/* in characters */
+    int bufferSize;		/* 0: unbuffered */
+    ResponseCompression compress;	/* decided with the first flush */
+    ResponseCompression accepted;	/* by the client, see first put */
+    int compressLevel;
+    int compressMin;		/* smaller responses are not compressed */
+    void *zstream;		/* Tcl_ZlibStream while compressing */
+    long compressIn;		/* bytes before compression */
+    long compressOut;		/* bytes after compression */
+    long compressTime;		/* microseconds spent compressing */
 }
 ResponseObj;
 
@@ -61,6 +95,13 @@ typedef enum PutxMarkup
 PutxMarkup;
 
 #define PUTXMARKUPDEFAULT 1
+#define PUTXMARKUPS 2
+#define PUTXCACHEDEFAULT 32	/* templates per markup, 0: no cache */
+#define PUTXFILECHECKDEFAULT 0	/* seconds between checks of putxfiles */
+#define PUTXVARSDEFAULT 0	/* {{$var}} in tag markup: off */
+#define OUTPUTBUFFERDEFAULT 0	/* of the default response object */
+#define COMPRESSIONDEFAULT 0	/* zlib level, 0: no compression */
+#define COMPRESSMINSIZEDEFAULT 1024	/* characters */
 
 typedef struct OutData
 {
@@ -68,6 +109,15 @@ typedef struct OutData
     ResponseObj *defaultResponseObj;
     /* private members */
     PutxMarkup putxMarkup;	/* markuptype for putx: brace ({}) |tag (<%%>) */
+    Tcl_HashTable *putxCache[PUTXMARKUPS];	/* template -> PutxTemplate */
+    int putxCacheSize;
+    long putxCacheTick;
+    Tcl_HashTable *putxFiles;	/* file name -> PutxFile */
+    int putxFileCheck;
+    int putxVars;		/* substitute {{$var}} in tag markup */
+    int outputBuffer;		/* buffer size of default response objects */
+    int compression;		/* level for default response objects */
+    int compressMinSize;
 }
 OutData;
 
@@ -89,10 +139,25 @@ ResponseObj *getResponseObj(Tcl_Interp * interp, OutData * outData,
 			    char *name);
 int putsCmdImpl(Tcl_Interp * interp, ResponseObj * responseObj,
 		Tcl_Obj * str);
+int flushResponseObj(Tcl_Interp * interp, ResponseObj * responseObj,
+		     ResponseFlush how);
+int flushAllResponseObjs(Tcl_Interp * interp);
+void configureResponseObj(OutData * outData, ResponseObj * responseObj);
+int setOutputBuffer(Tcl_Interp * interp, OutData * outData, int size);
+int setOutputCompression(Tcl_Interp * interp, OutData * outData, int level,
+			 int minSize);
+Tcl_Obj *responseCompressionStats(ResponseObj * responseObj);
 int webout_eval_brace(Tcl_Interp * interp, ResponseObj * responseObj,
 		      Tcl_Obj * in);
 int webout_eval_tag(Tcl_Interp * interp, ResponseObj * responseObj,
 		    Tcl_Obj * in, TCLCONST char *strstart, TCLCONST char *strend);
+int webout_eval_cached(Tcl_Interp * interp, OutData * outData,
+		       ResponseObj * responseObj, Tcl_Obj * in,
+		       TCLCONST char *strstart, TCLCONST char *strend);
+int webout_eval_file(Tcl_Interp * interp, OutData * outData,
+		     ResponseObj * responseObj, char *filename,
+		     TCLCONST char *strstart, TCLCONST char *strend);
+void webout_clear_cache(OutData * outData);
 
 /* need this for all "real channel based" (vs apache) output */
 int objectHeaderHandler(Tcl_Interp * interp, ResponseObj * responseObj,
@@ -117,4 +182,7 @@ int Web_Response(ClientData clientData,
 int Web_Eval(ClientData clientData,
 	     Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
 
+int Web_PutxFile(ClientData clientData,
+		 Tcl_Interp * interp, int objc, Tcl_Obj * CONST objv[]);
+
 #endif
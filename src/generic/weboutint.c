@@ -21,6 +21,8 @@
 #include "hashutl.h"
 #include "paramlist.h"		/* destroyParamList */
 #include "varchannel.h"
+#include "putxtmpl.h"
+#include "request.h"		/* Accept-Encoding */
 
 /* ----------------------------------------------------------------------------
  * getChannel
@@ -181,6 +183,18 @@ ResponseObj __declspec(dllexport) *createResponseObj(Tcl_Interp * interp, char *
     responseObj->name = Tcl_NewStringObj(channelName, -1);
     responseObj->httpresponse = NULL;
     responseObj->headerHandler = headerHandler;
+    responseObj->flushHandler = NULL;
+    responseObj->buffer = NULL;
+    responseObj->bufferLength = 0;
+    responseObj->bufferSize = 0;
+    responseObj->compress = COMPRESS_OFF;
+    responseObj->accepted = COMPRESS_OFF;
+    responseObj->compressLevel = 0;
+    responseObj->compressMin = 0;
+    responseObj->zstream = NULL;
+    responseObj->compressIn = 0;
+    responseObj->compressOut = 0;
+    responseObj->compressTime = 0;
 
     Tcl_IncrRefCount(responseObj->name);	/* it's mine */
 
@@ -202,6 +216,15 @@ int destroyResponseObj(ClientData clientData, Tcl_Interp * interp)
 
     /* unregister if was a varchannel */
 /*   printf("DBG destroyResponseObj '%s'\n",Tcl_GetString(responseObj->name)); fflush(stdout); */
+    /* what was put is sent, as it was without buffer */
+    if ((responseObj->buffer != NULL) || (responseObj->zstream != NULL))
+	flushResponseObj(interp, responseObj, FLUSH_FINISH);
+    WebDecrRefCountIfNotNull(responseObj->buffer);
+#ifdef WEBOUT_COMPRESS
+    if (responseObj->zstream != NULL)
+	Tcl_ZlibStreamClose((Tcl_ZlibStream) responseObj->zstream);
+#endif
+
     Web_UnregisterVarChannel(interp, Tcl_GetString(responseObj->name), NULL);
 
     WebDecrRefCountIfNotNull(responseObj->name);
@@ -276,6 +299,14 @@ int destroyResponseObjHash(OutData * outData, Tcl_Interp * interp)
     return TCL_OK;
 }
 
+/* ----------------------------------------------------------------------------
+ * outExitHandler -- output still buffered when the process ends (CGI)
+ * ------------------------------------------------------------------------- */
+static void outExitHandler(ClientData clientData)
+{
+    flushAllResponseObjs((Tcl_Interp *) clientData);
+}
+
 /* ----------------------------------------------------------------------------
  * createOutData
  * ------------------------------------------------------------------------- */
@@ -306,6 +337,19 @@ OutData *createOutData(Tcl_Interp * interp)
 	}
 
 	outData->putxMarkup = PUTXMARKUPDEFAULT;
+	outData->putxCache[brace] = NULL;
+	outData->putxCache[tag] = NULL;
+	outData->putxCacheSize = PUTXCACHEDEFAULT;
+	outData->putxCacheTick = 0;
+	outData->putxFiles = NULL;
+	outData->putxFileCheck = PUTXFILECHECKDEFAULT;
+	outData->putxVars = PUTXVARSDEFAULT;
+	outData->outputBuffer = OUTPUTBUFFERDEFAULT;
+	outData->compression = COMPRESSIONDEFAULT;
+	outData->compressMinSize = COMPRESSMINSIZEDEFAULT;
+	configureResponseObj(outData, outData->defaultResponseObj);
+
+	Tcl_CreateThreadExitHandler(outExitHandler, (ClientData) interp);
     }
 
     return outData;
@@ -330,6 +374,7 @@ int resetOutData(Tcl_Interp * interp, OutData * outData)
     outData->defaultResponseObj = createDefaultResponseObj(interp);
     if (outData->defaultResponseObj == NULL)
 	return TCL_ERROR;
+    configureResponseObj(outData, outData->defaultResponseObj);
 
     /* create Hash (and add default channel) */
     if (createResponseObjHash(outData) != TCL_OK)
@@ -352,166 +397,332 @@ int destroyOutData(ClientData clientData, Tcl_Interp * interp)
 
     outData = (OutData *) clientData;
 
+    Tcl_DeleteThreadExitHandler(outExitHandler, (ClientData) interp);
+
     /* delete all response Obj */
     destroyResponseObjHash(outData, interp);
 
+    webout_clear_cache(outData);
+
     WebFreeIfNotNull(outData);
 
     return TCL_OK;
 }
 
 /* ----------------------------------------------------------------------------
- * webout_eval_tag (code in <? ?>)
+ * webout_eval_tag -- compile and eval template (code in <? ?>), uncached
  * ------------------------------------------------------------------------- */
-#define PUTX_SUBST_IGNORE    0          // <? set abc 123 ?>
-#define PUTX_SUBST_RESULT    1          // <?= set abc 123 ?>
-#define PUTX_SUBST_VARIABLE  2          // <?= $abc ?>
 int webout_eval_tag(Tcl_Interp * interp, ResponseObj * responseObj,
 		    Tcl_Obj * in, TCLCONST char *strstart, TCLCONST char *strend)
 {
-  Tcl_Obj *outbuf;
-  Tcl_Obj *tclo;
-  char *next;
-  char *cur;
-
-  int endseqlen = strlen(strend);
-  int startseqlen = strlen(strstart);
-  int begin = 1;
-  int firstScan = 1;
-  int inside = 0;
-  int inLen = 0;
-  int res = 0;
-  int subst_result = PUTX_SUBST_IGNORE;
-
-  next = Tcl_GetStringFromObj(in, &inLen);
-  outbuf = Tcl_NewStringObj("", -1);
-  Tcl_IncrRefCount(outbuf);
-
-  if (inLen == 0) {
-    Tcl_DecrRefCount(outbuf);
-    return 0;
-  }
-
-
-  while (*next != 0) {
-    cur = next;
-    next = (char *)Tcl_UtfNext(cur);
-
-    if (strncmp("\\", cur, 1) == 0) {
-      if (firstScan == 1) { firstScan = 0; }
-      if (strncmp(strstart, next, startseqlen) == 0) {
-	Tcl_AppendToObj(outbuf, "\\", 1);
-	Tcl_AppendToObj(outbuf, strstart, startseqlen);
-	next += startseqlen;
-      } else if (strncmp(strend, next, endseqlen) == 0) {
-	Tcl_AppendToObj(outbuf, "\\", 1);
-	Tcl_AppendToObj(outbuf, strend, endseqlen);
-	next += endseqlen;
-      } else if (inside < 1) {
-	Tcl_AppendToObj(outbuf, "\\\\", 2);
-      } else {
-	Tcl_AppendToObj(outbuf, "\\", 1);
-      }
-    } else if (strncmp(strstart, cur, startseqlen) == 0) {
-      /* see start tag */
-      if ((++inside) == 1) {
-	if (firstScan == 1) {
-	  begin = 0;
-	  firstScan = 0;
-	  Tcl_AppendToObj(outbuf, "\n", 1);
-	} else {
-	  Tcl_AppendToObj(outbuf, "\"\n", 2);
-	}
-	if (startseqlen > 1) {
-	  next += startseqlen - 1;
+    OutData *outData;
+    PutxTemplate *tmpl;
+    int res;
+
+    outData = (OutData *) Tcl_GetAssocData(interp, WEB_OUT_ASSOC_DATA, NULL);
+    tmpl = putxCompile(in, strstart, strend,
+		       (outData != NULL) && outData->putxVars);
+    if (tmpl == NULL)
+	return TCL_ERROR;
+    res = putxEval(interp, outData, responseObj, tmpl, TCL_EVAL_DIRECT);
+    putxRelease(tmpl);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * writeToChannel -- write str to channel without newline translation,
+ * binary: str is a byte array (compressed output)
+ * ------------------------------------------------------------------------- */
+static int writeToChannel(Tcl_Interp * interp, ResponseObj * responseObj,
+			  Tcl_Channel channel, Tcl_Obj * str, int binary)
+{
+
+    long bytesSent = 0;
+    Tcl_DString translation;
+    Tcl_DString encoding;
+
+    /* make sure there is no additional newline translation */
+    Tcl_DStringInit(&translation);
+    Tcl_DStringInit(&encoding);
+    Tcl_GetChannelOption(interp, channel, "-translation", &translation);
+    if (binary) {
+	/* -translation binary sets the encoding too */
+	Tcl_GetChannelOption(interp, channel, "-encoding", &encoding);
+	Tcl_SetChannelOption(interp, channel, "-translation", "binary");
+    }
+    else
+	Tcl_SetChannelOption(interp, channel, "-translation", "lf");
+
+    bytesSent = Tcl_WriteObj(channel, str);
+
+    Tcl_SetChannelOption(interp, channel, "-translation", Tcl_DStringValue(&translation));
+    if (binary)
+	Tcl_SetChannelOption(interp, channel, "-encoding", Tcl_DStringValue(&encoding));
+    Tcl_DStringFree(&translation);
+    Tcl_DStringFree(&encoding);
+
+    if (bytesSent == -1) {
+
+	LOG_MSG(interp, WRITE_LOG | SET_RESULT,
+		__FILE__, __LINE__,
+		"web::put", WEBLOG_ERROR,
+		"error writing to response object:",
+		Tcl_GetStringResult(interp), NULL);
+	return TCL_ERROR;
+    }
+
+    responseObj->bytesSent += bytesSent;
+
+    /* flush varchannel */
+    if (responseObj->name != NULL) {
+	char *channelName = Tcl_GetString(responseObj->name);
+	if (channelName != NULL)
+	    if (channelName[0] == '#')
+		Tcl_Flush(channel);
+    }
+
+    return TCL_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * parseAcceptEncoding -- gzip or deflate, whichever has the higher q
+ * ------------------------------------------------------------------------- */
+static ResponseCompression parseAcceptEncoding(const char *accept)
+{
+
+    double gzip = -1.0;
+    double deflate = -1.0;
+    double any = -1.0;
+
+    while (*accept) {
+
+	const char *name;
+	int length;
+	double q = 1.0;
+
+	while ((*accept == ' ') || (*accept == '\t') || (*accept == ','))
+	    accept++;
+	name = accept;
+	while (*accept && (*accept != ',') && (*accept != ';')
+	       && (*accept != ' ') && (*accept != '\t'))
+	    accept++;
+	length = accept - name;
+
+	/* of the parameters, only q matters */
+	while (*accept && (*accept != ',')) {
+	    if (*accept++ != ';')
+		continue;
+	    while ((*accept == ' ') || (*accept == '\t'))
+		accept++;
+	    if (((*accept == 'q') || (*accept == 'Q')) && (accept[1] == '='))
+		q = atof(accept + 2);
 	}
 
-        /* see <?= ... ?> */
-        if(next[0] == '='){
-          subst_result = PUTX_SUBST_RESULT;
-          next++;  // skip '='
-          while(next[0]==' ' || next[0]=='\t') next++;
-          if(next[0]=='$') {
-            subst_result = PUTX_SUBST_VARIABLE;
-          }
-        } else {
-          subst_result = PUTX_SUBST_IGNORE;
-        }
-
-        /* TODO: <?= $var ?>  , {{$var}}, [[set var]] */
-
-	switch(subst_result){
-	    case PUTX_SUBST_IGNORE:
-	      break;
-	    case PUTX_SUBST_RESULT:
-              /* subst result */
-	      Tcl_AppendToObj(outbuf, "web::put [", -1);
-	      break;
-	    case PUTX_SUBST_VARIABLE:
-	      Tcl_AppendToObj(outbuf, "web::put ", -1);
-	      break;
-        }
-      }  else {
-	Tcl_AppendToObj(outbuf, cur, startseqlen);
-	if (startseqlen > 1) {
-	  next += startseqlen - 1;
+	if (((length == 4) && !Tcl_UtfNcasecmp(name, "gzip", 4))
+	    || ((length == 6) && !Tcl_UtfNcasecmp(name, "x-gzip", 6)))
+	    gzip = q;
+	else if ((length == 7) && !Tcl_UtfNcasecmp(name, "deflate", 7))
+	    deflate = q;
+	else if ((length == 1) && (*name == '*'))
+	    any = q;
+    }
+
+    if (gzip < 0.0)
+	gzip = any;
+    if (deflate < 0.0)
+	deflate = any;
+
+    if ((gzip > 0.0) && (gzip >= deflate))
+	return COMPRESS_GZIP;
+    if (deflate > 0.0)
+	return COMPRESS_DEFLATE;
+    return COMPRESS_OFF;
+}
+
+/* ----------------------------------------------------------------------------
+ * acceptedCompression -- what the client accepts (Accept-Encoding)
+ * ------------------------------------------------------------------------- */
+static ResponseCompression acceptedCompression(Tcl_Interp * interp)
+{
+
+    ResponseCompression compress = COMPRESS_OFF;
+#ifdef WEBOUT_COMPRESS
+    RequestData *requestData = NULL;
+    Tcl_InterpState state;
+    Tcl_Obj *accept = NULL;
+
+    requestData =
+	(RequestData *) Tcl_GetAssocData(interp, WEB_REQ_ASSOC_DATA, NULL);
+    if (requestData == NULL)
+	return COMPRESS_OFF;
+
+    /* the result of the command that puts must not get lost */
+    state = Tcl_SaveInterpState(interp, TCL_OK);
+    if (requestFillRequestValues(interp, requestData) == TCL_OK)
+	accept = paramListGetObjectByString(interp, requestData->request,
+					    "HTTP_ACCEPT_ENCODING");
+    Tcl_RestoreInterpState(interp, state);
+
+    if (accept != NULL) {
+	Tcl_IncrRefCount(accept);
+	compress = parseAcceptEncoding(Tcl_GetString(accept));
+	Tcl_DecrRefCount(accept);
+    }
+#endif
+    return compress;
+}
+
+/* ----------------------------------------------------------------------------
+ * startResponse -- decide on compression, then send the headers. With
+ * compression configured, this is postponed until the buffer is flushed the
+ * first time: a complete response smaller than compressMin is not worth it.
+ * ------------------------------------------------------------------------- */
+static int startResponse(Tcl_Interp * interp, ResponseObj * responseObj,
+			 Tcl_Channel channel, int length, ResponseFlush how)
+{
+
+    ResponseCompression compress = COMPRESS_OFF;
+    Tcl_Obj *headers = NULL;
+    int res = TCL_OK;
+
+#ifdef WEBOUT_COMPRESS
+    /* not if the script took care of the body itself */
+    if (responseObj->sendHeader
+	&& (getFromHashTable(responseObj->headers, "Content-Encoding") == NULL)
+	&& (getFromHashTable(responseObj->headers, "Content-Length") == NULL)) {
+
+	paramListAdd(responseObj->headers, "Vary",
+		     Tcl_NewStringObj("Accept-Encoding", -1));
+	if ((how != FLUSH_FINISH) || (length >= responseObj->compressMin))
+	    compress = responseObj->accepted;
+    }
+
+    if (compress != COMPRESS_OFF) {
+
+	Tcl_ZlibStream zstream = NULL;
+
+	if (Tcl_ZlibStreamInit(NULL, TCL_ZLIB_STREAM_DEFLATE,
+			       (compress == COMPRESS_GZIP) ?
+			       TCL_ZLIB_FORMAT_GZIP : TCL_ZLIB_FORMAT_ZLIB,
+			       responseObj->compressLevel, NULL,
+			       &zstream) != TCL_OK) {
+	    LOG_MSG(interp, WRITE_LOG, __FILE__, __LINE__,
+		    "web::put", WEBLOG_WARNING,
+		    "cannot compress response, sending it uncompressed", NULL);
+	    compress = COMPRESS_OFF;
 	}
-      }
-    } else if (strncmp(strend, cur, endseqlen) == 0) {
-      /* see end tag */
-      if (firstScan == 1) { firstScan = 0; }
-      if ((--inside) == 0) {
-
-        /* subst result */
-        if(subst_result==PUTX_SUBST_RESULT){
-	  Tcl_AppendToObj(outbuf, "]", -1);
-        }else if(subst_result==PUTX_SUBST_VARIABLE){
-	  Tcl_AppendToObj(outbuf, "", -1);
-        }
-
-	Tcl_AppendToObj(outbuf, "\nweb::put \"", -1);
-	if (endseqlen > 1) {
-	  next += endseqlen - 1;
+	else {
+	    responseObj->zstream = (void *) zstream;
+	    paramListAdd(responseObj->headers, "Content-Encoding",
+			 Tcl_NewStringObj((compress == COMPRESS_GZIP) ?
+					  "gzip" : "deflate", -1));
 	}
+    }
+#endif
+    responseObj->compress = compress;
+
+    if (!responseObj->sendHeader)
+	return TCL_OK;
 
-      } else {
-	Tcl_AppendToObj(outbuf, cur, endseqlen);
-	if (endseqlen > 1) {
-	  next += endseqlen - 1;
+    {
+	Tcl_Time tcltime;
+	Tcl_GetTime(&tcltime);
+	responseObj->firstbyte  = tcltime.sec*1000000 + tcltime.usec;
+    }
+
+    /* headers are never compressed */
+    headers = Tcl_NewObj();
+    Tcl_IncrRefCount(headers);
+    responseObj->headerHandler(interp, responseObj, headers);
+    if (Tcl_GetCharLength(headers) > 0)
+	res = writeToChannel(interp, responseObj, channel, headers, 0);
+    Tcl_DecrRefCount(headers);
+
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * compressToChannel -- encode str like the channel would, compress and write
+ * it. Output is held back by zlib until a sync point (FLUSH_SYNC) or the end
+ * of the response (FLUSH_FINISH).
+ * ------------------------------------------------------------------------- */
+static int compressToChannel(Tcl_Interp * interp, ResponseObj * responseObj,
+			     Tcl_Channel channel, Tcl_Obj * str,
+			     ResponseFlush how)
+{
+
+    int res = TCL_OK;
+#ifdef WEBOUT_COMPRESS
+    Tcl_ZlibStream zstream = (Tcl_ZlibStream) responseObj->zstream;
+    Tcl_DString encoded;
+    Tcl_DString option;
+    Tcl_Obj *in = NULL;
+    Tcl_Obj *out = NULL;
+    Tcl_Time start, end;
+    int flush = TCL_ZLIB_NO_FLUSH;
+    int length = 0;
+
+    if (how == FLUSH_SYNC)
+	flush = TCL_ZLIB_FLUSH;
+    else if (how == FLUSH_FINISH)
+	flush = TCL_ZLIB_FINALIZE;
+
+    Tcl_DStringInit(&encoded);
+    if (str != NULL) {
+
+	Tcl_DStringInit(&option);
+	Tcl_GetChannelOption(interp, channel, "-encoding", &option);
+	if (!strcmp(Tcl_DStringValue(&option), "binary")) {
+	    unsigned char *bytes = Tcl_GetByteArrayFromObj(str, &length);
+	    Tcl_DStringAppend(&encoded, (char *) bytes, length);
 	}
-      }
-      if (inside < 0) { inside = 0; }
-    } else if (inside < 1) {
-      if (firstScan == 1) { firstScan = 0; }
-      switch (*cur) {
-      case '{':
-      case '}':
-      case '$':
-      case '[':
-      case ']':
-      case '"':
-	Tcl_AppendToObj(outbuf, "\\", -1);
-      default:
-	Tcl_AppendToObj(outbuf, cur, next - cur);
-	break;
-      }
-    } else {
-      if (firstScan == 1) { firstScan = 0; }
-      Tcl_AppendToObj(outbuf, cur, next - cur);
+	else {
+	    Tcl_Encoding encoding =
+		Tcl_GetEncoding(NULL, Tcl_DStringValue(&option));
+	    Tcl_UtfToExternalDString(encoding, Tcl_GetString(str), -1,
+				     &encoded);
+	    Tcl_FreeEncoding(encoding);
+	}
+	Tcl_DStringFree(&option);
+    }
+
+    in = Tcl_NewByteArrayObj((unsigned char *) Tcl_DStringValue(&encoded),
+			     Tcl_DStringLength(&encoded));
+    Tcl_IncrRefCount(in);
+    out = Tcl_NewObj();
+    Tcl_IncrRefCount(out);
+
+    Tcl_GetTime(&start);
+    res = Tcl_ZlibStreamPut(zstream, in, flush);
+    if (res == TCL_OK)
+	res = Tcl_ZlibStreamGet(zstream, out, -1);
+    Tcl_GetTime(&end);
+
+    responseObj->compressTime +=
+	(end.sec - start.sec) * 1000000 + (end.usec - start.usec);
+    responseObj->compressIn += Tcl_DStringLength(&encoded);
+    Tcl_DStringFree(&encoded);
+    Tcl_DecrRefCount(in);
+
+    if (res != TCL_OK) {
+	LOG_MSG(interp, WRITE_LOG | SET_RESULT, __FILE__, __LINE__,
+		"web::put", WEBLOG_ERROR,
+		"error compressing response", NULL);
+    }
+    else {
+	Tcl_GetByteArrayFromObj(out, &length);
+	responseObj->compressOut += length;
+	if (length > 0)
+	    res = writeToChannel(interp, responseObj, channel, out, 1);
     }
-  }
-  if (begin) {
-    tclo = Tcl_NewStringObj("web::put \"", -1);
-    Tcl_IncrRefCount(tclo); 
-    Tcl_AppendObjToObj(tclo, outbuf);
-    Tcl_DecrRefCount(outbuf);
-  } else {
-    tclo = outbuf;
-  }
-  Tcl_AppendToObj(tclo, "\"", -1);
-  res = Tcl_EvalObjEx(interp, tclo, TCL_EVAL_DIRECT);
-  Tcl_DecrRefCount(tclo); 
-  return res;
+    Tcl_DecrRefCount(out);
+
+    if (flush == TCL_ZLIB_FINALIZE) {
+	Tcl_ZlibStreamClose(zstream);
+	responseObj->zstream = NULL;
+    }
+#endif
+    return res;
 }
 
 /* ----------------------------------------------------------------------------
@@ -521,9 +732,8 @@ int putsCmdImpl(Tcl_Interp * interp, ResponseObj * responseObj, Tcl_Obj * str)
 {
 
     Tcl_Obj *sendString = NULL;
-    long bytesSent = 0;
     Tcl_Channel channel;
-    Tcl_DString translation;
+    int res;
 
     /* --------------------------------------------------------------------------
      * sanity
@@ -533,6 +743,40 @@ int putsCmdImpl(Tcl_Interp * interp, ResponseObj * responseObj, Tcl_Obj * str)
 
 /*   printf("DBG putsCmdImpl - got '%s'\n",Tcl_GetString(str)); fflush(stdout); */
 
+    /* --------------------------------------------------------------------------
+     * buffered: the channel is only accessed when the buffer is flushed
+     * ----------------------------------------------------------------------- */
+    if ((responseObj->bufferSize > 0)
+	|| (responseObj->compress != COMPRESS_OFF)) {
+
+	if (responseObj->buffer == NULL) {
+	    /* the request is gone when the last flush happens at exit */
+	    if (responseObj->compress == COMPRESS_UNDECIDED)
+		responseObj->accepted = acceptedCompression(interp);
+	    responseObj->buffer = Tcl_NewObj();
+	    Tcl_IncrRefCount(responseObj->buffer);
+	}
+
+	/* undecided compression: the headers are sent by startResponse */
+	if (responseObj->sendHeader
+	    && (responseObj->compress != COMPRESS_UNDECIDED)) {
+	    Tcl_Time tcltime;
+	    Tcl_GetTime(&tcltime);
+	    responseObj->firstbyte  = tcltime.sec*1000000 + tcltime.usec;
+	    responseObj->headerHandler(interp, responseObj, responseObj->buffer);
+	}
+
+	Tcl_AppendObjToObj(responseObj->buffer, str);
+	responseObj->bufferLength += Tcl_GetCharLength(str);
+
+	/* compression is decided on compressMin characters at least */
+	if ((responseObj->bufferLength >= responseObj->bufferSize)
+	    && ((responseObj->compress != COMPRESS_UNDECIDED)
+		|| (responseObj->bufferLength >= responseObj->compressMin)))
+	    return flushResponseObj(interp, responseObj, FLUSH_BUFFER);
+	return TCL_OK;
+    }
+
     channel = getChannel(interp, responseObj);
     if (channel == NULL)
 	return TCL_ERROR;
@@ -550,40 +794,203 @@ int putsCmdImpl(Tcl_Interp * interp, ResponseObj * responseObj, Tcl_Obj * str)
 
     Tcl_AppendObjToObj(sendString, str);
 
-    /* make sure there is no additional newline translation */
-    Tcl_DStringInit(&translation);
-    Tcl_GetChannelOption(interp, channel, "-translation", &translation);
-    Tcl_SetChannelOption(interp, channel, "-translation", "lf");
+    res = writeToChannel(interp, responseObj, channel, sendString, 0);
 
-    if ((bytesSent = Tcl_WriteObj(channel, sendString)) == -1) {
+    Tcl_DecrRefCount(sendString);
 
-	LOG_MSG(interp, WRITE_LOG | SET_RESULT,
-		__FILE__, __LINE__,
-		"web::put", WEBLOG_ERROR,
-		"error writing to response object:",
-		Tcl_GetStringResult(interp), NULL);
-	Tcl_DecrRefCount(sendString);
-	Tcl_SetChannelOption(interp, channel, "-translation", Tcl_DStringValue(&translation));
-	Tcl_DStringFree(&translation);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * flushResponseObj -- write the buffered output to the channel, which is
+ * flushed too. Compressed output goes out at sync points and at the end only.
+ * ------------------------------------------------------------------------- */
+int flushResponseObj(Tcl_Interp * interp, ResponseObj * responseObj,
+		     ResponseFlush how)
+{
+
+    Tcl_Obj *buffer = NULL;
+    Tcl_Channel channel;
+    int length;
+    int res = TCL_OK;
+
+    if (responseObj == NULL)
+	return TCL_ERROR;
+    if ((responseObj->buffer == NULL)
+	&& ((responseObj->zstream == NULL) || (how == FLUSH_BUFFER)))
+	return TCL_OK;
+
+    buffer = responseObj->buffer;
+    length = responseObj->bufferLength;
+    responseObj->buffer = NULL;
+    responseObj->bufferLength = 0;
+
+    channel = getChannel(interp, responseObj);
+    if (channel == NULL) {
+	WebDecrRefCountIfNotNull(buffer);
 	return TCL_ERROR;
     }
 
-    Tcl_SetChannelOption(interp, channel, "-translation", Tcl_DStringValue(&translation));
-    Tcl_DStringFree(&translation);
-    responseObj->bytesSent += bytesSent;
+    if (responseObj->compress == COMPRESS_UNDECIDED)
+	res = startResponse(interp, responseObj, channel, length, how);
 
-    /* flush varchannel */
-    if (responseObj->name != NULL) {
-	char *channelName = Tcl_GetString(responseObj->name);
-	if (channelName != NULL)
-	    if (channelName[0] == '#')
-		Tcl_Flush(channel);
+    if (res == TCL_OK) {
+	if (responseObj->zstream != NULL)
+	    res = compressToChannel(interp, responseObj, channel, buffer, how);
+	else if (buffer != NULL)
+	    res = writeToChannel(interp, responseObj, channel, buffer, 0);
+    }
+    WebDecrRefCountIfNotNull(buffer);
+
+    if (res == TCL_OK)
+	Tcl_Flush(channel);
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * flushAllResponseObjs -- at the end of the request
+ * ------------------------------------------------------------------------- */
+int flushAllResponseObjs(Tcl_Interp * interp)
+{
+
+    OutData *outData;
+    HashTableIterator iterator;
+    ResponseObj *responseObj = NULL;
+    int res = TCL_OK;
+
+    outData = (OutData *) Tcl_GetAssocData(interp, WEB_OUT_ASSOC_DATA, NULL);
+    if ((outData == NULL) || (outData->responseObjHash == NULL))
+	return TCL_ERROR;
+
+    assignIteratorToHashTable(outData->responseObjHash, &iterator);
+
+    while (nextFromHashIterator(&iterator) != TCL_ERROR) {
+
+	responseObj = (ResponseObj *) valueOfCurrent(&iterator);
+	if (responseObj != NULL)
+	    if (flushResponseObj(interp, responseObj, FLUSH_FINISH) != TCL_OK)
+		res = TCL_ERROR;
+    }
+
+    return res;
+}
+
+/* ----------------------------------------------------------------------------
+ * configureResponseObj -- buffer and compression of a default response
+ * object. Compression can only be changed as long as no headers were sent.
+ * ------------------------------------------------------------------------- */
+void configureResponseObj(OutData * outData, ResponseObj * responseObj)
+{
+
+    if ((outData == NULL) || (responseObj == NULL))
+	return;
+
+    responseObj->bufferSize = outData->outputBuffer;
+
+    if (responseObj->sendHeader && (responseObj->zstream == NULL)
+	&& ((responseObj->compress == COMPRESS_OFF)
+	    || (responseObj->compress == COMPRESS_UNDECIDED))) {
+	responseObj->compressLevel = outData->compression;
+	responseObj->compressMin = outData->compressMinSize;
+	responseObj->compress = (outData->compression > 0) ?
+	    COMPRESS_UNDECIDED : COMPRESS_OFF;
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * configureDefaultResponseObjs -- apply the configuration of outData
+ * ------------------------------------------------------------------------- */
+static int configureDefaultResponseObjs(Tcl_Interp * interp,
+					OutData * outData)
+{
+
+    HashTableIterator iterator;
+    ResponseObj *responseObj = NULL;
+
+    assignIteratorToHashTable(outData->responseObjHash, &iterator);
+
+    while (nextFromHashIterator(&iterator) != TCL_ERROR) {
+
+	responseObj = (ResponseObj *) valueOfCurrent(&iterator);
+	if ((responseObj != NULL)
+	    && isDefaultResponseObj(interp, Tcl_GetString(responseObj->name))) {
+	    if (flushResponseObj(interp, responseObj, FLUSH_BUFFER) != TCL_OK)
+		return TCL_ERROR;
+	    configureResponseObj(outData, responseObj);
+	}
     }
 
-    Tcl_DecrRefCount(sendString);
     return TCL_OK;
 }
 
+/* ----------------------------------------------------------------------------
+ * setOutputBuffer -- buffer size of the default response objects
+ * ------------------------------------------------------------------------- */
+int setOutputBuffer(Tcl_Interp * interp, OutData * outData, int size)
+{
+
+    if ((outData == NULL) || (outData->responseObjHash == NULL))
+	return TCL_ERROR;
+
+    outData->outputBuffer = (size > 0) ? size : 0;
+
+    return configureDefaultResponseObjs(interp, outData);
+}
+
+/* ----------------------------------------------------------------------------
+ * setOutputCompression -- zlib level (0: off) and minimum size of the
+ * default response objects
+ * ------------------------------------------------------------------------- */
+int setOutputCompression(Tcl_Interp * interp, OutData * outData, int level,
+			 int minSize)
+{
+
+    if ((outData == NULL) || (outData->responseObjHash == NULL))
+	return TCL_ERROR;
+
+#ifdef WEBOUT_COMPRESS
+    outData->compression = (level < 0) ? 0 : ((level > 9) ? 9 : level);
+#else
+    outData->compression = 0;
+#endif
+    outData->compressMinSize = (minSize > 0) ? minSize : 0;
+
+    return configureDefaultResponseObjs(interp, outData);
+}
+
+/* ----------------------------------------------------------------------------
+ * responseCompressionStats -- for web::response -compression
+ * ------------------------------------------------------------------------- */
+Tcl_Obj *responseCompressionStats(ResponseObj * responseObj)
+{
+
+    Tcl_Obj *stats = Tcl_NewObj();
+    char *encoding = "identity";
+
+    if (responseObj->compress == COMPRESS_GZIP)
+	encoding = "gzip";
+    else if (responseObj->compress == COMPRESS_DEFLATE)
+	encoding = "deflate";
+
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj("encoding", -1));
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj(encoding, -1));
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj("in", -1));
+    Tcl_ListObjAppendElement(NULL, stats,
+			     Tcl_NewLongObj(responseObj->compressIn));
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj("out", -1));
+    Tcl_ListObjAppendElement(NULL, stats,
+			     Tcl_NewLongObj(responseObj->compressOut));
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj("saved", -1));
+    Tcl_ListObjAppendElement(NULL, stats,
+			     Tcl_NewLongObj(responseObj->compressIn -
+					    responseObj->compressOut));
+    Tcl_ListObjAppendElement(NULL, stats, Tcl_NewStringObj("time", -1));
+    Tcl_ListObjAppendElement(NULL, stats,
+			     Tcl_NewLongObj(responseObj->compressTime));
+
+    return stats;
+}
+
 /* ----------------------------------------------------------------------------
  * objectHeaderHandler -- send headers into a Tcl_Obj, used for variables and channels
  * ------------------------------------------------------------------------- */
@@ -14,7 +14,12 @@
  */
 
 #include <tcl.h>
+#include <stdio.h>
 #include <string.h>		/* strlen */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>		/* mallinfo2 */
+#define WEB_MALLINFO
+#endif
 #include "webutl.h"
 
 /* ----------------------------------------------------------------------------
@@ -328,3 +333,70 @@ Tcl_Obj *Web_GetOrCreateGlobalVar(Tcl_Interp * interp, Tcl_Obj * name,
 
     return var;
 }
+
+/* ----------------------------------------------------------------------------
+ * webThreadMemoryInUse -- bytes the Tcl allocator of the current thread has
+ * handed out and not got back (-1 if unknown). The interps of a thread are
+ * used by one request at a time, so the growth during a request belongs
+ * to its interp. Blocks larger than the allocator's buckets (16k) go to
+ * the system allocator and are not counted.
+ * ------------------------------------------------------------------------- */
+#if defined(TCL_THREADS) && (TCL_MAJOR_VERSION > 8 || (TCL_MAJOR_VERSION == 8 && TCL_MINOR_VERSION >= 5))
+#define WEB_THREAD_MEMORY
+#endif
+
+Tcl_WideInt webThreadMemoryInUse(void)
+{
+    Tcl_WideInt inuse = -1;
+#ifdef WEB_THREAD_MEMORY
+    Tcl_DString ds;
+    char me[64];
+    int numcaches = 0, numbuckets = 0, i, j;
+    TCLCONST char **caches = NULL;
+    TCLCONST char **buckets = NULL;
+    long assigned;
+    size_t len;
+
+    sprintf(me, "thread%p", (void *) Tcl_GetCurrentThread());
+    len = strlen(me);
+
+    Tcl_DStringInit(&ds);
+    Tcl_GetMemoryInfo(&ds);
+    if (Tcl_SplitList(NULL, Tcl_DStringValue(&ds), &numcaches, &caches) == TCL_OK) {
+	for (i = 0; i < numcaches; i++) {
+	    /* {threadADDR {size numFree numRemoves numInserts totalAssigned ...} ...} */
+	    if (strncmp(caches[i], me, len) || caches[i][len] != ' ')
+		continue;
+	    if (Tcl_SplitList(NULL, caches[i], &numbuckets, &buckets) == TCL_OK) {
+		inuse = 0;
+		for (j = 1; j < numbuckets; j++) {
+		    if (sscanf(buckets[j], "%*s %*s %*s %*s %ld", &assigned) == 1)
+			inuse += assigned;
+		}
+		Tcl_Free((char *) buckets);
+	    }
+	    break;
+	}
+	Tcl_Free((char *) caches);
+    }
+    Tcl_DStringFree(&ds);
+#endif /* WEB_THREAD_MEMORY */
+    return inuse;
+}
+
+/* ----------------------------------------------------------------------------
+ * webHeapInUse -- bytes malloc has handed out in the whole process: Tcl_Obj
+ * batches and large blocks included, but also what other threads allocate
+ * meanwhile. Small blocks are taken by the Tcl allocator in batches, so
+ * this is coarse. Without glibc, webThreadMemoryInUse.
+ * ------------------------------------------------------------------------- */
+Tcl_WideInt webHeapInUse(void)
+{
+#ifdef WEB_MALLINFO
+    struct mallinfo2 info = mallinfo2();
+
+    return (Tcl_WideInt) (info.uordblks + info.hblkhd);
+#else /* WEB_MALLINFO */
+    return webThreadMemoryInUse();
+#endif /* WEB_MALLINFO */
+}
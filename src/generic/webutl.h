@@ -40,4 +40,7 @@ int deleteTclObj_fnc(void *tclo, void *dum);
 Tcl_Obj *Web_GetOrCreateGlobalVar(Tcl_Interp * interp, Tcl_Obj * name,
 				  int *isNew);
 
+Tcl_WideInt webThreadMemoryInUse(void);
+Tcl_WideInt webHeapInUse(void);
+
 #endif